@@ -0,0 +1,114 @@
+#ifndef TIMSORT_ARGSORT_H
+#define TIMSORT_ARGSORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+
+
+namespace tim {
+
+/**
+ * @brief Write the stably sorted order of [begin, end) with respect to
+ *        'comp' to [indices, indices + (end - begin)), without moving
+ *        any elements.
+ *
+ * Afterwards begin[indices[0]], begin[indices[1]], ... are in sorted order,
+ * and equal elements' indices are in increasing order.  The indices are
+ * what gets sorted (with the usual memcpy() paths when 'indices' is
+ * contiguous), so the cost doesn't depend on how big the elements are.
+ * A 32-bit index type halves the memory traffic for ranges that fit;
+ * std::length_error is thrown for ranges that don't fit the index type.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class IndexIt, class Comp>
+void argsort_into(It begin, It end, IndexIt indices, Comp comp)
+{
+	using index_type = internal::iterator_value_type_t<IndexIt>;
+	static_assert(std::is_integral_v<index_type>, "argsort_into() needs an integral index type.");
+	const std::size_t count = end - begin;
+	if(count > 0 and count - 1 > static_cast<std::make_unsigned_t<index_type>>(std::numeric_limits<index_type>::max()))
+		throw std::length_error("tim::argsort_into(): range too long for the index type");
+	std::iota(indices, indices + count, index_type(0));
+	internal::_timsort<MergePolicy>(indices, indices + count,
+		[begin, comp](index_type left, index_type right) {
+			return comp(begin[left], begin[right]);
+		}
+	);
+}
+
+template <class MergePolicy = timsort_merge_policy, class It, class IndexIt>
+void argsort_into(It begin, It end, IndexIt indices)
+{
+	argsort_into<MergePolicy>(begin, end, indices, tim::internal::DefaultComparator{});
+}
+
+/**
+ * @brief Return the stably sorted order of [begin, end) with respect to
+ *        'comp' as a vector of indices.  See argsort_into().
+ *
+ * 'Index' is std::size_t by default, because the return type can't
+ * depend on how long the range turns out to be.  Pass std::uint32_t for
+ * ranges known to have fewer than 2^32 elements to halve the size of the
+ * permutation.  Sorting 32-bit indices internally and widening them
+ * afterwards wasn't worth its temporary array: with comparisons going
+ * through the elements, the narrower indices only saved ~5%.
+ */
+template <class Index = std::size_t, class MergePolicy = timsort_merge_policy, class It, class Comp>
+std::vector<Index> argsort(It begin, It end, Comp comp)
+{
+	std::vector<Index> indices(end - begin);
+	argsort_into<MergePolicy>(begin, end, indices.begin(), comp);
+	return indices;
+}
+
+template <class Index = std::size_t, class MergePolicy = timsort_merge_policy, class It>
+std::vector<Index> argsort(It begin, It end)
+{
+	return argsort<Index, MergePolicy>(begin, end, tim::internal::DefaultComparator{});
+}
+
+/**
+ * @brief Move the elements of [begin, end) so that the element that was
+ *        at begin[indices[i]] ends up at begin[i], e.g. to put them in
+ *        the order given by argsort().
+ *
+ * Follows each cycle of the permutation, so every element is moved once,
+ * plus one move through a temporary per cycle.  Visited positions are
+ * marked in 'indices' itself, so [indices, indices + (end - begin)) must
+ * be a permutation of 0, ..., end - begin - 1, and is left holding the
+ * identity permutation.  'indices' only needs 'indices[i]' to give an
+ * assignable integer, so it may also be an accessor over some other
+ * structure's index field.
+ */
+template <class It, class IndexIt>
+void apply_permutation(It begin, It end, IndexIt indices)
+{
+	using index_type = std::decay_t<decltype(indices[0])>;
+	const std::size_t count = end - begin;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		if(static_cast<std::size_t>(indices[i]) == i)
+			continue;
+		auto temp = std::move(begin[i]);
+		std::size_t dest = i;
+		for(std::size_t src = indices[dest]; src != i; src = indices[dest])
+		{
+			begin[dest] = std::move(begin[src]);
+			indices[dest] = static_cast<index_type>(dest);
+			dest = src;
+		}
+		begin[dest] = std::move(temp);
+		indices[dest] = static_cast<index_type>(dest);
+	}
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_ARGSORT_H */
@@ -41,6 +41,11 @@
 #   define COMPILER_UNLIKELY_(x) (x)
 #  endif
 
+#  if (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__)
+#   define COMPILER_X86_SIMD_ 1
+#   define COMPILER_TARGET_(features) __attribute__((target(features)))
+#  endif
+
 # else
 #  define COMPILER_LIKELY_(x)   (x)
 #  define COMPILER_UNLIKELY_(x) (x)
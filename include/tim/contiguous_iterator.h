@@ -11,11 +11,36 @@
 #ifdef __has_include
 # if __has_include(<string_view>)
 #  include <string_view>
+#  define TIMSORT_HAS_STRING_VIEW
 # endif
+# if __has_include(<version>)
+#  include <version>
+# endif
+#endif
+#if __cplusplus >= 202002L and defined(__cpp_lib_concepts)
+# define TIMSORT_HAS_CONTIGUOUS_ITERATOR_CONCEPT
 #endif
 
 
 namespace tim {
+
+/**
+ * Whether 'It' iterates over elements that are next to each other in 
+ * memory, like a pointer does, so that timsort() can move trivially 
+ * copyable elements with memcpy().  
+ *
+ * Pointers and the iterators of std::vector, std::basic_string, 
+ * std::basic_string_view and std::valarray are detected, and when 
+ * compiling as C++20, so is anything that models std::contiguous_iterator
+ * (std::array, std::span, ...).  Specialize this for other iterators, e.g.
+ * 	template <class T>
+ * 	struct tim::is_contiguous_iterator<arena_vector_iterator<T>>: std::true_type {};
+ * &*it must point to the element.  std::reverse_iterator<It> is then 
+ * detected as contiguous in reverse, for any of these.
+ */
+template <class It>
+struct is_contiguous_iterator: std::false_type {};
+
 namespace internal {
 
 template <class It>
@@ -36,7 +61,11 @@ public:
 
 };
 
-template <class It, bool = std::is_pod_v<iterator_value_type_t<It>>>
+/* std::is_pod_v, which is deprecated in C++20. */
+template <class T>
+inline constexpr const bool is_trivial_standard_layout_v = std::is_trivial_v<T> and std::is_standard_layout_v<T>;
+
+template <class It, bool = is_trivial_standard_layout_v<iterator_value_type_t<It>>>
 struct is_string_iterator;
 
 template <class It>
@@ -51,7 +80,7 @@ struct is_string_iterator<It, true>
 template <class It>
 struct is_string_iterator<It, false> : std::false_type {};
 
-template <class It, bool = std::is_pod_v<iterator_value_type_t<It>>>
+template <class It, bool = is_trivial_standard_layout_v<iterator_value_type_t<It>>>
 struct is_string_view_iterator;
 
 template <class It>
@@ -59,27 +88,25 @@ struct is_string_view_iterator<It, true>
 {
 	using _value_type = iterator_value_type_t<It>;
 	static constexpr const bool value = 
-		   std::is_same_v<It, typename std::basic_string<_value_type>::iterator>
-	        or std::is_same_v<It, typename std::basic_string<_value_type>::const_iterator>;
+#ifdef TIMSORT_HAS_STRING_VIEW
+		   std::is_same_v<It, typename std::basic_string_view<_value_type>::iterator>
+	        or std::is_same_v<It, typename std::basic_string_view<_value_type>::const_iterator>;
+#else
+		false;
+#endif
 };
 
 template <class It>
 struct is_string_view_iterator<It, false> : std::false_type {};
 
+/* Whether 'It' models std::contiguous_iterator, when compiling as C++20. */
 template <class It>
-struct is_stringview_iterator
-{
-	using _value_type = iterator_value_type_t<It>;
-	static constexpr const bool value = 
-#ifdef __has_include
-# if __has_include(<string_view>)
-		   std::is_same_v<It, typename std::basic_string_view<_value_type>::iterator>
-		or std::is_same_v<It, typename std::basic_string_view<_value_type>::const_iterator>;
-# else
-		false;
-# endif
+inline constexpr const bool models_contiguous_iterator_v =
+#ifdef TIMSORT_HAS_CONTIGUOUS_ITERATOR_CONCEPT
+	std::contiguous_iterator<It>;
+#else
+	false;
 #endif
-};
 
 template <class It>
 struct is_vector_iterator
@@ -95,7 +122,9 @@ struct is_contiguous_iterator
 {
 	using _value_type = iterator_value_type_t<It>;
 	static constexpr const bool value = 
-			(is_vector_iterator<It>::value and not std::is_same_v<_value_type, bool>)
+			tim::is_contiguous_iterator<It>::value
+			or models_contiguous_iterator_v<It>
+			or (is_vector_iterator<It>::value and not std::is_same_v<_value_type, bool>)
 			or is_string_iterator<It>::value 
 			or is_string_view_iterator<It>::value 
 			or is_valarray_iterator<It>::value;
@@ -129,5 +158,8 @@ inline constexpr const bool is_reverse_contiguous_iterator_v = is_reverse_contig
 } /* namespace internal */
 } /* namespace tim */
 
+#undef TIMSORT_HAS_STRING_VIEW
+#undef TIMSORT_HAS_CONTIGUOUS_ITERATOR_CONCEPT
+
 
 #endif /* TIMSORT_CONTIGUOUS_ITERATOR_H */
@@ -0,0 +1,375 @@
+#ifndef TIMSORT_EXTERNAL_SORT_H
+#define TIMSORT_EXTERNAL_SORT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+#include "loser_tree.h"
+
+
+namespace tim {
+
+struct external_sort_options
+{
+	/** Bytes of memory to sort and merge in. */
+	std::size_t memory_budget = std::size_t(256) << 20;
+	/** Where sorted runs are spilled.  Empty means std::filesystem::temp_directory_path(). */
+	std::filesystem::path temp_directory;
+	/**
+	 * Smallest read or write worth doing while merging.  Merges read this
+	 * much from each run at a time, at least, so memory_budget / io_block_size
+	 * runs are merged at once.  If there are more, they're merged in passes.
+	 */
+	std::size_t io_block_size = std::size_t(1) << 20;
+};
+
+struct external_sort_stats
+{
+	/** Records sorted. */
+	std::size_t records = 0;
+	/** Sorted runs spilled to temporary files. */
+	std::size_t runs = 0;
+	/** Passes over the data merging runs, including the one that wrote the output. */
+	std::size_t merge_passes = 0;
+};
+
+namespace internal {
+
+[[noreturn]] inline void throw_external_sort_error(const char* what, const std::filesystem::path& path)
+{
+	throw std::system_error(errno, std::generic_category(),
+				std::string("tim::external_sort: ") + what + " '" + path.string() + "'");
+}
+
+/* Unbuffered binary file of fixed-width records; all reads and writes are big ones. */
+class record_file
+{
+public:
+	record_file(const std::filesystem::path& file_path, const char* mode):
+		path(file_path),
+		file(std::fopen(file_path.c_str(), mode))
+	{
+		if(not file)
+			throw_external_sort_error("can't open", path);
+		std::setvbuf(file, nullptr, _IONBF, 0);
+	}
+
+	/* Take ownership of 'f', already open on 'file_path'. */
+	record_file(const std::filesystem::path& file_path, std::FILE* f):
+		path(file_path),
+		file(f)
+	{
+		std::setvbuf(file, nullptr, _IONBF, 0);
+	}
+
+	record_file(const record_file&) = delete;
+	record_file& operator=(const record_file&) = delete;
+
+	~record_file()
+	{
+		if(file)
+			std::fclose(file);
+	}
+
+	/* Read up to 'count' records into 'records'.  Returns how many were read; 0 at the end. */
+	template <class T>
+	std::size_t read(T* records, std::size_t count)
+	{
+		const std::size_t got = std::fread(records, sizeof(T), count, file);
+		if(got < count and std::ferror(file))
+			throw_external_sort_error("can't read", path);
+		return got;
+	}
+
+	template <class T>
+	void write(const T* records, std::size_t count)
+	{
+		if(std::fwrite(records, sizeof(T), count, file) != count)
+			throw_external_sort_error("can't write", path);
+	}
+
+	const std::filesystem::path& name() const
+	{
+		return path;
+	}
+
+	/* Close the file, throwing if anything written didn't make it. */
+	void close()
+	{
+		std::FILE* f = std::exchange(file, nullptr);
+		if(std::fclose(f) != 0)
+			throw_external_sort_error("can't write", path);
+	}
+
+private:
+	std::filesystem::path path;
+	std::FILE* file;
+};
+
+/*
+ * Temporary run files, removed when done with or when the sort fails.
+ * Each one is created exclusively, so a file or symlink that's already
+ * there under the same name is never written through or removed.
+ */
+class temp_run_files
+{
+public:
+	explicit temp_run_files(std::filesystem::path dir):
+		directory(dir.empty() ? std::filesystem::temp_directory_path() : std::move(dir)),
+		prefix(random_prefix())
+	{
+
+	}
+
+	temp_run_files(const temp_run_files&) = delete;
+	temp_run_files& operator=(const temp_run_files&) = delete;
+
+	~temp_run_files()
+	{
+		std::error_code ignored;
+		for(const auto& p: paths)
+			std::filesystem::remove(p, ignored);
+	}
+
+	/* Create a new, empty run file and open it for writing. */
+	std::unique_ptr<record_file> create()
+	{
+		for(int attempts = 0; ; ++attempts)
+		{
+			std::filesystem::path p = directory / (prefix + std::to_string(paths.size()) + ".run");
+			if(std::FILE* f = std::fopen(p.c_str(), "wbx"))
+			{
+				paths.push_back(p);
+				return std::make_unique<record_file>(p, f);
+			}
+			if(errno != EEXIST or attempts == 100)
+				throw_external_sort_error("can't create", p);
+			prefix = random_prefix();
+		}
+	}
+
+	void remove(const std::filesystem::path& p) noexcept
+	{
+		std::error_code ignored;
+		std::filesystem::remove(p, ignored);
+	}
+
+private:
+	static std::string random_prefix()
+	{
+		std::random_device rd;
+		const std::uint64_t bits = (std::uint64_t(rd()) << 32) ^ rd();
+		return "tim-external-sort-" + std::to_string(bits) + "-";
+	}
+
+	std::filesystem::path directory;
+	std::string prefix;
+	std::vector<std::filesystem::path> paths;
+};
+
+/* Sequential reader for one sorted run, 'capacity' records at a time. */
+template <class T>
+struct run_reader
+{
+	run_reader(const std::filesystem::path& path, T* buf, std::size_t cap):
+		file(path, "rb"),
+		buffer(buf),
+		capacity(cap)
+	{
+
+	}
+
+	/* First record not yet taken, or nullptr at the end of the run. */
+	const T* fill()
+	{
+		position = 0;
+		count = file.read(buffer, capacity);
+		return count > 0 ? buffer : nullptr;
+	}
+
+	const T* next()
+	{
+		if(++position < count)
+			return buffer + position;
+		return fill();
+	}
+
+	record_file file;
+	T* buffer;
+	std::size_t capacity;
+	std::size_t position = 0;
+	std::size_t count = 0;
+};
+
+/*
+ * Merge the sorted runs in 'runs' into 'writer' in one pass, splitting
+ * 'memory' evenly between a read buffer for each run and the write buffer.
+ * Runs are ordered as in the input, and ties go to the earlier run, so the
+ * merge is stable.
+ */
+template <class T, class Comp>
+void merge_run_files(const std::vector<std::filesystem::path>& runs, record_file& writer,
+		     std::vector<T>& memory, Comp comp)
+{
+	const std::size_t share = memory.size() / (runs.size() + 1);
+	std::deque<run_reader<T>> readers;
+	loser_tree<T, Comp> tree(runs.size(), comp);
+	for(std::size_t i = 0; i < runs.size(); ++i)
+	{
+		readers.emplace_back(runs[i], memory.data() + i * share, share);
+		tree.set_head(i, readers[i].fill());
+	}
+	tree.build();
+	T* const out = memory.data() + runs.size() * share;
+	const std::size_t out_capacity = memory.size() - runs.size() * share;
+	std::size_t out_count = 0;
+	while(const T* head = tree.winner_head())
+	{
+		out[out_count++] = *head;
+		if(out_count == out_capacity)
+		{
+			writer.write(out, out_count);
+			out_count = 0;
+		}
+		tree.replace(readers[tree.winner()].next());
+	}
+	writer.write(out, out_count);
+	writer.close();
+}
+
+} /* namespace internal */
+
+
+/**
+ * @brief Stably sort the fixed-width records of type 'T' in the file
+ *        'input' with respect to 'comp', writing them to 'output'.
+ *
+ * For files too big to sort in memory.  The input is read in chunks as big
+ * as two thirds of options.memory_budget, and each chunk is sorted with
+ * timsort() (the other third is its merge buffer) and spilled to a
+ * temporary file in options.temp_directory.  A chunk that carries on where
+ * the last one left off (its first record doesn't go before the last
+ * record spilled) is appended to the same file, so presorted input makes
+ * a single run, and input with long natural runs makes few.  The runs are
+ * then merged with a k-way merge, reading and writing in big sequential
+ * blocks.  Equal records keep their original order, within chunks and
+ * across them.  Input that fits in one chunk is sorted in memory without
+ * spilling at all.
+ *
+ * 'T' must be trivially copyable and default constructible; the files are
+ * arrays of its object representation.  'output' may be 'input'.  Errors
+ * are thrown as std::system_error, and the temporary files are removed
+ * whether the sort succeeds or not.
+ */
+template <class T, class MergePolicy = timsort_merge_policy, class Comp>
+external_sort_stats external_sort(const std::filesystem::path& input, const std::filesystem::path& output,
+				  Comp comp, const external_sort_options& options = external_sort_options{})
+{
+	static_assert(std::is_trivially_copyable_v<T>, "tim::external_sort() sorts files of trivially copyable records.");
+	external_sort_stats stats;
+	const std::uintmax_t bytes = std::filesystem::file_size(input);
+	if(bytes % sizeof(T) != 0)
+	{
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+					"tim::external_sort: '" + input.string() + "' isn't a whole number of records");
+	}
+	stats.records = static_cast<std::size_t>(bytes / sizeof(T));
+
+	const std::size_t budget = std::max<std::size_t>(options.memory_budget / sizeof(T), 4);
+	const std::size_t io_block = std::max<std::size_t>(options.io_block_size / sizeof(T), 1);
+	const std::size_t chunk_capacity = budget - budget / 3;
+	std::vector<T> memory(std::min<std::size_t>(budget, stats.records + stats.records / 2 + 1));
+	const std::size_t chunk_size = std::min(chunk_capacity, memory.size() - memory.size() / 3);
+	scratch_span<T> scratch(memory.data() + chunk_size, memory.size() - chunk_size);
+
+	// spill sorted chunks, extending the current run while chunks continue it
+	internal::temp_run_files temp_files(options.temp_directory);
+	std::vector<std::filesystem::path> runs;
+	{
+		internal::record_file reader(input, "rb");
+		if(stats.records <= chunk_size)
+		{
+			const std::size_t count = reader.read(memory.data(), stats.records);
+			timsort<MergePolicy>(memory.data(), memory.data() + count, comp, scratch);
+			internal::record_file writer(output, "wb");
+			writer.write(memory.data(), count);
+			writer.close();
+			return stats;
+		}
+		std::unique_ptr<internal::record_file> spill;
+		T last;
+		while(const std::size_t count = reader.read(memory.data(), chunk_size))
+		{
+			timsort<MergePolicy>(memory.data(), memory.data() + count, comp, scratch);
+			if(not spill or comp(memory[0], last))
+			{
+				if(spill)
+					spill->close();
+				spill = temp_files.create();
+				runs.push_back(spill->name());
+			}
+			spill->write(memory.data(), count);
+			last = memory[count - 1];
+		}
+		if(spill)
+			spill->close();
+	}
+	stats.runs = runs.size();
+
+	// merge in passes of at most 'fan_in' runs until the last pass can write the output
+	const std::size_t fan_in = std::max<std::size_t>(budget / io_block, 3) - 1;
+	while(runs.size() > fan_in)
+	{
+		std::vector<std::filesystem::path> merged;
+		for(std::size_t first = 0; first < runs.size(); first += fan_in)
+		{
+			const std::size_t last_run = std::min(first + fan_in, runs.size());
+			if(last_run - first == 1)
+			{
+				merged.push_back(runs[first]);
+				continue;
+			}
+			std::vector<std::filesystem::path> group(runs.begin() + first, runs.begin() + last_run);
+			auto writer = temp_files.create();
+			merged.push_back(writer->name());
+			internal::merge_run_files(group, *writer, memory, comp);
+			for(const auto& p: group)
+				temp_files.remove(p);
+		}
+		runs = std::move(merged);
+		++stats.merge_passes;
+	}
+	if(runs.size() == 1)
+	{
+		std::error_code error;
+		std::filesystem::rename(runs.front(), output, error);
+		if(not error)
+			return stats;
+	}
+	internal::record_file writer(output, "wb");
+	internal::merge_run_files(runs, writer, memory, comp);
+	++stats.merge_passes;
+	return stats;
+}
+
+template <class T, class MergePolicy = timsort_merge_policy>
+external_sort_stats external_sort(const std::filesystem::path& input, const std::filesystem::path& output)
+{
+	return external_sort<T, MergePolicy>(input, output, internal::DefaultComparator{});
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_EXTERNAL_SORT_H */
@@ -0,0 +1,480 @@
+#ifndef TIMSORT_INCREMENTAL_SORT_H
+#define TIMSORT_INCREMENTAL_SORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+
+
+namespace tim {
+
+/**
+ * Shared flag for cancelling incremental sorts.  Copies refer to the same
+ * flag, so keep one and hand a copy to the sorter.  cancel() may be called
+ * from any thread.
+ */
+struct cancellation_token
+{
+	cancellation_token():
+		cancelled_(std::make_shared<std::atomic<bool>>(false))
+	{
+
+	}
+
+	void cancel() const noexcept
+	{
+		cancelled_->store(true, std::memory_order_relaxed);
+	}
+
+	bool cancelled() const noexcept
+	{
+		return cancelled_->load(std::memory_order_relaxed);
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+enum class sort_status
+{
+	/** There's more work to do. */
+	running,
+	/** The range is sorted. */
+	done,
+	/** The sort was cancelled.  The range is a permutation of what it was. */
+	cancelled
+};
+
+/**
+ * @brief A timsort of [begin, end) that runs a bounded amount at a time.
+ *
+ * Each call to step(budget) finds runs and merges them until it has done
+ * about 'budget' elements' worth of work (elements scanned, sorted into
+ * runs or moved by merges), then returns.  Runs that may be longer than
+ * that (presorted input, say) are scanned, and reversed if they start out
+ * descending, 'budget' elements at a time.  Merges longer than that are
+ * done in pieces: each piece merges the next 'budget' elements of output,
+ * found by binary searching for the matching cuts in both runs, and hands
+ * the part between the first and last elements that actually interleave
+ * to the usual merge routine (galloping, or vectorized for integers).
+ * All state lives in the sorter, so the caller can go do something else
+ * between steps.
+ *
+ * The range must not be touched until the sort is done or cancelled.
+ * Cancelling (through the token, or cancel()) puts any elements held in
+ * the merge buffer back, leaving the range a permutation of the input.
+ *
+ * Not copyable or movable, because the run stack isn't.
+ */
+template <class It, class Comp = internal::DefaultComparator, class MergePolicy = timsort_merge_policy>
+struct incremental_sorter
+{
+	using value_type = internal::iterator_value_type_t<It>;
+
+	incremental_sorter(It begin, It end, Comp comp = Comp{}, cancellation_token token = cancellation_token{}):
+		sorter_(begin, end, comp),
+		token_(std::move(token)),
+		status_((end - begin) > 1 ? sort_status::running : sort_status::done)
+	{
+
+	}
+
+	/**
+	 * @brief Do about 'budget' elements' worth of work.
+	 * @return Where the sort is at.
+	 */
+	sort_status step(std::size_t budget)
+	{
+		budget = std::max(budget, min_budget);
+		for(std::size_t work = 0; status_ == sort_status::running and work < budget;)
+		{
+			if(token_.cancelled())
+			{
+				abandon_merge();
+				status_ = sort_status::cancelled;
+			}
+			else if(merge_.active)
+				work += continue_merge(budget - work);
+			else
+				work += next_task(budget - work);
+		}
+		return status_;
+	}
+
+	/** @brief Finish the sort (unless it gets cancelled). */
+	sort_status run()
+	{
+		while(step(std::size_t(-1)) == sort_status::running) { /* LOOP */ }
+		return status_;
+	}
+
+	/** @brief Stop sorting.  Takes effect immediately. */
+	void cancel()
+	{
+		token_.cancel();
+		if(status_ == sort_status::running)
+		{
+			abandon_merge();
+			status_ = sort_status::cancelled;
+		}
+	}
+
+	sort_status status() const noexcept
+	{
+		return status_;
+	}
+
+private:
+	enum class phase
+	{
+		find_run,
+		resolve_invariants,
+		collapse
+	};
+
+	/*
+	 * A merge in progress.  It's done in a frame of reference where the
+	 * run that went into 'buffer' is on the left: forward from the start
+	 * of the merge, or backward from its end (with the comparator
+	 * reversed) if the right run was the smaller one.  Offsets are from
+	 * the start of the frame.
+	 */
+	struct merge_state
+	{
+		bool active = false;
+		bool backward = false;
+		/** Which runs on the stack are being merged. */
+		internal::merge_action action = internal::merge_action::none;
+		/** Offsets of the start and end of the merge in the range. */
+		std::size_t begin = 0;
+		std::size_t end = 0;
+		/** Length of the buffered (left) run and of the other one. */
+		std::size_t left_size = 0;
+		std::size_t right_size = 0;
+		/** How many elements of each have been merged so far. */
+		std::size_t left_done = 0;
+		std::size_t right_done = 0;
+		/** The first buffer.size() elements of the left run, in frame order. */
+		std::vector<value_type> buffer;
+	};
+
+	/*
+	 * A run being found in pieces.  [position, position + length) is what
+	 * has been scanned of it so far.
+	 */
+	struct scan_state
+	{
+		bool active = false;
+		/** Whether the scan is still in the strictly descending start. */
+		bool descending = false;
+		/** Whether that start is being reversed, and how many pairs have been swapped. */
+		bool reversing = false;
+		std::size_t reversed = 0;
+		/** Whether the run started out descending (for the stats). */
+		bool found_descending = false;
+		std::size_t length = 0;
+	};
+
+	/* Smallest budget worth setting up a step for. */
+	static constexpr const std::size_t min_budget = 1024;
+
+	/*
+	 * Find the next run, make the next merge the policy asks for, or
+	 * start collapsing the stack.  Returns the work done.
+	 */
+	std::size_t next_task(std::size_t budget)
+	{
+		auto& stack = sorter_.stack_buffer;
+		switch(phase_)
+		{
+		case phase::find_run:
+		{
+			if(sorter_.position == sorter_.stop)
+			{
+				phase_ = phase::collapse;
+				return 0;
+			}
+			const auto run_begin = sorter_.position;
+			std::size_t work = 0;
+			if(scan_.active or std::size_t(sorter_.stop - run_begin) > budget)
+			{
+				// the run could be longer than the budget
+				work = scan_piece(budget);
+				if(scan_.active)
+					return work;
+			}
+			else
+			{
+				sorter_.find_next_run();
+				work = sorter_.position - run_begin;
+			}
+			next_run_end_ = sorter_.position - sorter_.start;
+			if(stack.run_count() == 0)
+			{
+				// the first run goes on the stack unconditionally
+				stack.push(next_run_end_);
+				return work;
+			}
+			sorter_.merge_policy.begin_run(stack, sorter_.stop - sorter_.start, next_run_end_);
+			phase_ = phase::resolve_invariants;
+			return work;
+		}
+		case phase::resolve_invariants:
+		{
+			const auto action = sorter_.merge_policy.next_merge(stack);
+			if(action == internal::merge_action::none)
+			{
+				sorter_.merge_policy.end_run(stack);
+				stack.push(next_run_end_);
+				phase_ = phase::find_run;
+				return 0;
+			}
+			return start_merge(action, budget);
+		}
+		default:
+			if(stack.run_count() > 1)
+				return start_merge(internal::merge_action::merge_BC, budget);
+			status_ = sort_status::done;
+			return 0;
+		}
+	}
+
+	/*
+	 * Find the next run about 'budget' elements at a time, the way
+	 * TimSort::find_next_run() does: scan a strictly descending start,
+	 * reverse it (swapping from both ends inward), then scan on for an
+	 * ascending continuation.  Runs that turn out shorter than minrun are
+	 * handed to find_next_run() to be extended, before anything has been
+	 * reversed.  Returns the work done.  Once 'scan_' is inactive again,
+	 * 'position' is the end of the run.
+	 */
+	std::size_t scan_piece(std::size_t budget)
+	{
+		auto& scan = scan_;
+		const It run = sorter_.position;
+		const std::size_t remain = sorter_.stop - run;
+		if(not scan.active)
+		{
+			scan.active = true;
+			scan.descending = sorter_.comp(run[1], run[0]);
+			scan.reversing = false;
+			scan.length = 2;
+			scan.reversed = 0;
+		}
+		std::size_t work = 0;
+		if(scan.reversing)
+		{
+			const std::size_t half = scan.length / 2;
+			const std::size_t count = std::min(budget, half - scan.reversed);
+			std::swap_ranges(run + scan.reversed, run + (scan.reversed + count),
+					 std::make_reverse_iterator(run + (scan.length - scan.reversed)));
+			scan.reversed += count;
+			if(scan.reversed < half)
+				return 2 * count;
+			scan.reversing = false;
+			scan.descending = false;
+			work = 2 * count;
+			budget -= std::min(budget, work);
+		}
+		const std::size_t before = scan.length;
+		const std::size_t limit = std::min(remain, scan.length + std::max<std::size_t>(budget, 1));
+		if(scan.descending)
+			scan.length = sorter_.template scan_run<true>(scan.length, limit);
+		else
+			scan.length = sorter_.template scan_run<false>(scan.length, limit);
+		work += scan.length - before;
+		if(scan.length == limit and limit < remain)
+			return work;
+		if(scan.length < remain and scan.length < sorter_.minrun and scan.reversed == 0)
+		{
+			// short: rescan it and extend it as usual
+			scan.active = false;
+			sorter_.find_next_run();
+			return work + (sorter_.position - run);
+		}
+		if(scan.descending)
+		{
+			scan.reversing = true;
+			scan.found_descending = true;
+			return work;
+		}
+		sorter_.stats.found_run(scan.length, scan.found_descending, false);
+		sorter_.position += scan.length;
+		scan.active = false;
+		scan.found_descending = false;
+		return work;
+	}
+
+	/*
+	 * Merge the runs 'action' refers to if it fits in 'budget', otherwise
+	 * set up a merge in pieces.
+	 */
+	std::size_t start_merge(internal::merge_action action, std::size_t budget)
+	{
+		const bool merge_AB = action == internal::merge_action::merge_AB;
+		const std::size_t begin = merge_AB ? sorter_.template get_offset<3>() : sorter_.template get_offset<2>();
+		const std::size_t mid = merge_AB ? sorter_.template get_offset<2>() : sorter_.template get_offset<1>();
+		const std::size_t end = merge_AB ? sorter_.template get_offset<1>() : sorter_.template get_offset<0>();
+		if(end - begin <= budget)
+		{
+			if(merge_AB)
+				sorter_.merge_AB();
+			else
+				sorter_.merge_BC();
+			return end - begin;
+		}
+		// trim what's already in place, just like TimSort::merge_runs()
+		const It start = sorter_.start;
+		const auto comp = sorter_.comp;
+		const It lo = internal::gallop_upper_bound(start + begin, start + mid, start[mid], comp);
+		const It hi = internal::gallop_upper_bound(std::make_reverse_iterator(start + end),
+							   std::make_reverse_iterator(start + mid),
+							   start[mid - 1],
+							   [comp](auto&& a, auto&& b) {
+								return comp(std::forward<decltype(b)>(b), std::forward<decltype(a)>(a));
+							   }).base();
+		merge_.action = action;
+		merge_.begin = lo - start;
+		merge_.end = hi - start;
+		merge_.backward = (hi - (start + mid)) <= ((start + mid) - lo);
+		merge_.left_size = merge_.backward ? merge_.end - mid : mid - merge_.begin;
+		merge_.right_size = merge_.backward ? mid - merge_.begin : merge_.end - mid;
+		merge_.left_done = 0;
+		merge_.right_done = 0;
+		merge_.buffer.clear();
+		merge_.buffer.reserve(merge_.left_size);
+		merge_.active = merge_.left_size > 0 and merge_.right_size > 0;
+		if(not merge_.active)
+			finish_merge();
+		return (lo - (start + begin)) + ((start + end) - hi);
+	}
+
+	std::size_t continue_merge(std::size_t budget)
+	{
+		budget = std::max(budget, min_budget);
+		const auto comp = sorter_.comp;
+		if(merge_.backward)
+			return merge_piece(std::make_reverse_iterator(sorter_.start + merge_.end),
+					   [comp](auto&& a, auto&& b) {
+						return comp(std::forward<decltype(b)>(b), std::forward<decltype(a)>(a));
+					   },
+					   budget);
+		else
+			return merge_piece(sorter_.start + merge_.begin, comp, budget);
+	}
+
+	/*
+	 * Merge the next 'budget' elements of output in the frame starting at
+	 * 'base'.  Returns the work done.
+	 */
+	template <class Iter, class Cmp>
+	std::size_t merge_piece(Iter base, Cmp cmp, std::size_t budget)
+	{
+		auto& m = merge_;
+		auto& buffer = m.buffer;
+		const std::size_t dest = m.left_done + m.right_done;
+		const std::size_t count = std::min(budget, m.left_size + m.right_size - dest);
+		// anything in the left run that's about to be overwritten goes into
+		// the buffer first.  the rest of it is still in place.
+		const std::size_t fill_to = std::min(m.left_size, dest + count);
+		for(std::size_t i = buffer.size(); i < fill_to; ++i)
+			buffer.push_back(std::move(base[i]));
+		const auto left_at = [&](std::size_t i) -> const value_type& {
+			return i < buffer.size() ? buffer[i] : base[i];
+		};
+		const Iter right = base + (m.left_size + m.right_done);
+		// find how many of the next 'count' come from the left run: the i
+		// such that everything before the cut on both sides belongs before
+		// everything after it, taking the left run first on ties.
+		std::size_t lo = count > (m.right_size - m.right_done) ? count - (m.right_size - m.right_done) : 0;
+		std::size_t hi = std::min(count, m.left_size - m.left_done);
+		while(lo < hi)
+		{
+			const std::size_t i = lo + (hi - lo) / 2;
+			const std::size_t j = count - i;
+			// take more from the left if its next element doesn't come
+			// after the last one taken from the right
+			if(not cmp(right[j - 1], left_at(m.left_done + i)))
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		const std::size_t left_count = lo;
+		const std::size_t right_count = count - lo;
+		value_type* const left = buffer.data() + m.left_done;
+		const Iter out = base + dest;
+		// elements that are already in order at either end of the piece
+		// are moved in bulk, and only the part in between is merged.
+		std::size_t head = 0;
+		std::size_t tail = 0;
+		if(left_count > 0 and right_count > 0)
+		{
+			head = internal::gallop_upper_bound(left, left + left_count, *right, cmp) - left;
+			tail = std::lower_bound(right, right + right_count, left[left_count - 1], cmp) - right;
+		}
+		internal::move_or_memcpy(left, left + head, out);
+		if(head < left_count and tail > 0)
+			sorter_.merge_buffered(left + head, left + left_count, right, right + tail, out + head, cmp);
+		else
+			internal::move_or_memcpy(left + head, left + left_count, out + head);
+		// once the left run runs out, the rest of the right run is already
+		// where it belongs
+		if(m.left_done + left_count < m.left_size)
+			std::move(right + tail, right + right_count, out + left_count + tail);
+		m.left_done += left_count;
+		m.right_done += right_count;
+		if(m.left_done == m.left_size)
+			finish_merge();
+		return count;
+	}
+
+	void finish_merge()
+	{
+		merge_.active = false;
+		merge_.buffer.clear();
+		auto& stack = sorter_.stack_buffer;
+		if(merge_.action == internal::merge_action::merge_AB)
+			stack.template remove_run<2>();
+		else
+			stack.template remove_run<1>();
+	}
+
+	/*
+	 * Put the buffered elements of an unfinished merge back into the gap
+	 * they left in the range.
+	 */
+	void abandon_merge()
+	{
+		if(not merge_.active)
+			return;
+		const auto put_back = [&](auto base) {
+			auto& m = merge_;
+			for(std::size_t i = m.buffer.size(); i < m.left_size; ++i)
+				m.buffer.push_back(std::move(base[i]));
+			std::move(m.buffer.begin() + m.left_done, m.buffer.end(), base + (m.left_done + m.right_done));
+		};
+		if(merge_.backward)
+			put_back(std::make_reverse_iterator(sorter_.start + merge_.end));
+		else
+			put_back(sorter_.start + merge_.begin);
+		merge_.active = false;
+		merge_.buffer.clear();
+	}
+
+	internal::TimSort<It, Comp, MergePolicy> sorter_;
+	cancellation_token token_;
+	sort_status status_;
+	phase phase_ = phase::find_run;
+	std::size_t next_run_end_ = 0;
+	scan_state scan_;
+	merge_state merge_;
+};
+
+} /* namespace tim */
+
+#endif /* TIMSORT_INCREMENTAL_SORT_H */
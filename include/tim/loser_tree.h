@@ -0,0 +1,143 @@
+#ifndef TIMSORT_LOSER_TREE_H
+#define TIMSORT_LOSER_TREE_H
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace tim {
+namespace internal {
+
+/** Whether timsort() may finish with a multiway merge (see TimSort::try_multiway_collapse()). */
+#ifdef TIMSORT_NO_MULTIWAY_COLLAPSE
+inline constexpr const bool multiway_collapse_allowed = false;
+#else
+inline constexpr const bool multiway_collapse_allowed = true;
+#endif
+
+/**
+ * @brief Tournament tree for stable k-way merges.
+ *
+ * Holds a pointer to the current head of each of 'count' sorted sources
+ * (nullptr once a source is exhausted).  winner() is the source whose head
+ * comes next in the merged output: the smallest head, and of equal heads,
+ * the one from the source with the lowest index.  So merging sources in
+ * the order they appear in the input is stable.
+ *
+ * After taking the winner's head, point it at its next element (or at
+ * nothing) with replace(), which replays only the winner's path to the
+ * root: ceil(log2(count)) comparisons per element.
+ *
+ * With a nonzero 'MaxSources', the tree lives in fixed-size arrays, so
+ * that it never allocates, and 'count' must be at most 'MaxSources'.
+ * Otherwise it's as big as it needs to be.
+ */
+template <class T, class Comp, std::size_t MaxSources = 0>
+struct loser_tree
+{
+	template <class U, std::size_t N>
+	using storage_t = std::conditional_t<MaxSources == 0, std::vector<U>, std::array<U, N>>;
+
+	loser_tree(std::size_t count, Comp comp_func):
+		sources(count),
+		comp(comp_func)
+	{
+		if constexpr(MaxSources == 0)
+		{
+			heads.resize(count, nullptr);
+			losers.resize(count, 0);
+		}
+	}
+
+	std::size_t size() const noexcept
+	{
+		return sources;
+	}
+
+	/** @brief Set the head of 'source'.  Call build() once they're all set. */
+	void set_head(std::size_t source, const T* head) noexcept
+	{
+		heads[source] = head;
+	}
+
+	/** @brief Play the whole tournament. */
+	void build()
+	{
+		const std::size_t count = size();
+		// winners[node] is the winner of the subtree at 'node'.  the
+		// leaves are count, ..., 2 * count - 1.
+		storage_t<std::size_t, 2 * MaxSources> winners{};
+		if constexpr(MaxSources == 0)
+			winners.resize(2 * count);
+		for(std::size_t i = 0; i < count; ++i)
+			winners[count + i] = i;
+		for(std::size_t node = count; node-- > 1;)
+		{
+			std::size_t left = winners[2 * node];
+			std::size_t right = winners[2 * node + 1];
+			if(beats(right, left))
+				std::swap(left, right);
+			winners[node] = left;
+			losers[node] = right;
+		}
+		top = count > 1 ? winners[1] : 0;
+	}
+
+	/** @brief Source whose head is next, or one with no head if they're all exhausted. */
+	std::size_t winner() const noexcept
+	{
+		return top;
+	}
+
+	const T* winner_head() const noexcept
+	{
+		return heads[top];
+	}
+
+	/** @brief Replace the winner's head and find the new winner. */
+	void replace(const T* head)
+	{
+		heads[top] = head;
+		std::size_t winner = top;
+		for(std::size_t node = (winner + size()) / 2; node > 0; node /= 2)
+		{
+			// branch-free: who wins is as good as random
+			const std::size_t loser = losers[node];
+			const bool swap = beats(loser, winner);
+			losers[node] = swap ? winner : loser;
+			winner = swap ? loser : winner;
+		}
+		top = winner;
+	}
+
+private:
+	/* Whether source 'a''s head goes before source 'b''s. */
+	inline bool beats(std::size_t a, std::size_t b) const
+	{
+		if(not heads[a])
+			return false;
+		else if(not heads[b])
+			return true;
+		// ties go to the lower index: a beats b iff not (b < a) when
+		// a < b, and iff a < b otherwise.  branch-free on which it is.
+		const bool flip = a < b;
+		const T* const left = flip ? heads[b] : heads[a];
+		const T* const right = flip ? heads[a] : heads[b];
+		return comp(*left, *right) != flip;
+	}
+
+	std::size_t sources;
+	storage_t<const T*, MaxSources> heads{};
+	/** losers[node] is the source that lost the match at internal node 'node'. */
+	storage_t<std::size_t, MaxSources> losers{};
+	std::size_t top = 0;
+	Comp comp;
+};
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_LOSER_TREE_H */
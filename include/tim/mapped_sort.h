@@ -0,0 +1,195 @@
+#ifndef TIMSORT_MAPPED_SORT_H
+#define TIMSORT_MAPPED_SORT_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "timsort.h"
+
+
+namespace tim {
+
+/** Where mapped_sort() keeps its merge buffer. */
+enum class mapped_scratch
+{
+	/** Anonymous memory, backed by swap. */
+	anonymous,
+	/**
+	 * A mapping of an unlinked temporary file in the options' temp_directory,
+	 * so that under memory pressure the kernel can write the buffer back to
+	 * that file instead of swapping.
+	 */
+	temp_file
+};
+
+struct mapped_sort_options
+{
+	mapped_scratch scratch = mapped_scratch::anonymous;
+	/** Directory for mapped_scratch::temp_file.  Empty means std::filesystem::temp_directory_path(). */
+	std::filesystem::path temp_directory;
+	/** msync() the file before returning, so that it's on disk rather than just in the page cache. */
+	bool sync = false;
+};
+
+namespace internal {
+
+[[noreturn]] inline void throw_mapped_sort_error(const char* what, const std::filesystem::path& path)
+{
+	throw std::system_error(errno, std::generic_category(),
+				std::string("tim::mapped_sort: ") + what + " '" + path.string() + "'");
+}
+
+/* Owning file descriptor. */
+class file_descriptor
+{
+public:
+	explicit file_descriptor(int file_descriptor) noexcept:
+		fd(file_descriptor)
+	{
+
+	}
+
+	file_descriptor(const file_descriptor&) = delete;
+	file_descriptor& operator=(const file_descriptor&) = delete;
+
+	~file_descriptor()
+	{
+		if(fd >= 0)
+			::close(fd);
+	}
+
+	int get() const noexcept
+	{
+		return fd;
+	}
+
+private:
+	int fd;
+};
+
+/* Owning memory mapping. */
+class mapped_region
+{
+public:
+	mapped_region(std::size_t length, int prot, int flags, int fd, const std::filesystem::path& path):
+		size(length),
+		address(::mmap(nullptr, length, prot, flags, fd, 0))
+	{
+		if(address == MAP_FAILED)
+			throw_mapped_sort_error("can't map", path);
+	}
+
+	mapped_region(const mapped_region&) = delete;
+	mapped_region& operator=(const mapped_region&) = delete;
+
+	~mapped_region()
+	{
+		::munmap(address, size);
+	}
+
+	void* data() const noexcept
+	{
+		return address;
+	}
+
+	/* Hint how the mapping is about to be used.  Only advice, so failures are ignored. */
+	void advise(int advice) const noexcept
+	{
+		::madvise(address, size, advice);
+	}
+
+private:
+	std::size_t size;
+	void* address;
+};
+
+/* Map 'bytes' of scratch memory as 'options' say. */
+inline mapped_region map_scratch(std::size_t bytes, const mapped_sort_options& options)
+{
+	if(options.scratch == mapped_scratch::anonymous)
+		return mapped_region(bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, "<anonymous>");
+	const auto dir = options.temp_directory.empty() ? std::filesystem::temp_directory_path() : options.temp_directory;
+	std::string name = (dir / "tim-mapped-sort-XXXXXX").string();
+	file_descriptor file(::mkstemp(name.data()));
+	if(file.get() < 0)
+		throw_mapped_sort_error("can't create", name);
+	// nothing else needs to see the file, and this way it's gone even if we crash
+	::unlink(name.c_str());
+	if(::ftruncate(file.get(), static_cast<off_t>(bytes)) != 0)
+		throw_mapped_sort_error("can't resize", name);
+	return mapped_region(bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.get(), name);
+}
+
+} /* namespace internal */
+
+
+/**
+ * @brief Stably sort the fixed-width records of type 'T' in the file at
+ *        'path' in place, with respect to 'comp'.
+ * @return The number of records sorted.
+ *
+ * The file is mapped into memory and sorted where it lies with timsort(),
+ * so 'T' gets the same memcpy() fast paths as a std::vector<T> would,
+ * without reading the file into one and writing it back: no copies of the
+ * data beyond the page cache and the merge buffer (half the file, at most).
+ * The buffer is mapped too, from anonymous memory or from an unlinked
+ * temporary file (see mapped_scratch).  The file's mapping is advised as
+ * 'will need' and 'sequential', which suits run detection and merging.
+ *
+ * 'T' must be trivially copyable; the file is an array of its object
+ * representation.  POSIX only.  Errors are thrown as std::system_error.
+ * 'comp' shouldn't throw: if it does part way through a merge, the records
+ * held in the merge buffer are lost with it, and the file is left with
+ * those slots overwritten by duplicates of other records.
+ */
+template <class T, class MergePolicy = timsort_merge_policy, class Comp>
+std::size_t mapped_sort(const std::filesystem::path& path, Comp comp,
+			const mapped_sort_options& options = mapped_sort_options{})
+{
+	static_assert(std::is_trivially_copyable_v<T>, "tim::mapped_sort() sorts files of trivially copyable records.");
+	internal::file_descriptor file(::open(path.c_str(), O_RDWR));
+	if(file.get() < 0)
+		internal::throw_mapped_sort_error("can't open", path);
+	struct stat info;
+	if(::fstat(file.get(), &info) != 0)
+		internal::throw_mapped_sort_error("can't stat", path);
+	const std::size_t bytes = static_cast<std::size_t>(info.st_size);
+	if(bytes % sizeof(T) != 0)
+	{
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+					"tim::mapped_sort: '" + path.string() + "' isn't a whole number of records");
+	}
+	const std::size_t count = bytes / sizeof(T);
+	if(count < 2)
+		return count;
+
+	internal::mapped_region records(bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.get(), path);
+	records.advise(MADV_WILLNEED);
+	records.advise(MADV_SEQUENTIAL);
+	T* const begin = static_cast<T*>(records.data());
+	const std::size_t scratch_count = scratch_elements_needed(count);
+	internal::mapped_region scratch = internal::map_scratch(scratch_count * sizeof(T), options);
+	timsort<MergePolicy>(begin, begin + count, comp, scratch_span<T>(static_cast<T*>(scratch.data()), scratch_count));
+	if(options.sync and ::msync(records.data(), bytes, MS_SYNC) != 0)
+		internal::throw_mapped_sort_error("can't sync", path);
+	return count;
+}
+
+template <class T, class MergePolicy = timsort_merge_policy>
+std::size_t mapped_sort(const std::filesystem::path& path, const mapped_sort_options& options = mapped_sort_options{})
+{
+	return mapped_sort<T, MergePolicy>(path, internal::DefaultComparator{}, options);
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_MAPPED_SORT_H */
@@ -4,6 +4,7 @@
 #include "iter.h"
 #include <algorithm>
 #include <cstring>
+#include <memory>
 
 namespace tim {
 namespace internal {
@@ -24,7 +25,7 @@ struct GetMemcpyIterator
 {
 	static iterator_value_type_t<It>* get(It iter) noexcept
 	{
-		return &(*iter);
+		return std::addressof(*iter);
 	}
 };
 
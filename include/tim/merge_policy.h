@@ -0,0 +1,197 @@
+#ifndef TIMSORT_MERGE_POLICY_H
+#define TIMSORT_MERGE_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include "timsort_stack_buffer.h"
+
+
+namespace tim {
+namespace internal {
+
+/**
+ * What a merge policy wants done to the run stack before the next run is
+ * pushed.  The labels follow timsort_stack_buffer's naming: C is the run
+ * at the top of the stack, B the one below it and A the one below that.
+ */
+enum class merge_action
+{
+	none,
+	merge_AB,
+	merge_BC
+};
+
+} /* namespace internal */
+
+/*
+ * MERGE POLICIES
+ *
+ * A merge policy decides which runs on the run stack get merged as new
+ * runs are found.  The sorter drives it as follows every time it has found
+ * a new run (but before the run is pushed on to the stack):
+ *
+ * 	policy.begin_run(stack, n, next_run_end);
+ * 	while((action = policy.next_merge(stack)) != merge_action::none)
+ * 		perform 'action' on the stack;
+ * 	policy.end_run(stack);
+ * 	push the new run;
+ *
+ * where 'n' is the length of the whole range being sorted and 'next_run_end'
+ * is the offset one-past-the-end of the new run.  'stack' always holds at
+ * least one run when begin_run() is called.  Once all runs have been found
+ * the stack is collapsed by merging the top two runs until one is left.
+ */
+
+/**
+ * The classic Timsort merge pattern, as described in Tim Peters' listsort.txt.
+ *
+ * Assume the run stack has the following form:
+ * 	[ ..., W, X, Y, Z]
+ * Where Z is the length of the run at the top of the run stack.
+ *
+ * This policy continually merges with Y with Z or X with Y until
+ * the following invariants are satisfied:
+ * 	(1) X > Y + Z
+ * 	  (1.1) W > X + Y
+ *      (2) Y > Z
+ *
+ * If (1) or (1.1) are not satisfied, Y is merged with the smaller of
+ * X and Z.  Otherwise if (2) is not satisfied, Y and Z are merged.
+ *
+ * This gives a reasonable upper bound on the size of the run stack.
+ *
+ *   NOTE:
+ *   invariant (1.1) implements a fix for a bug in the original
+ *   implementation described here:
+ *   http://envisage-project.eu/wp-content/uploads/2015/02/sorting.pdf
+ *
+ *   The original description of these invariants written by Tim Peters
+ *   accounts for only the top three runs and refers to them as: A, B,
+ *   and C.  This implementation uses Tim's labelling scheme in some
+ *   function names, but implements the corrected invariants as
+ *   described above.
+ *
+ * ALSO NOTE:
+ *
+ * For more details see:
+ * https://github.com/python/cpython/blob/master/Objects/listsort.txt
+ */
+struct timsort_merge_policy
+{
+	template <class Stack>
+	inline void begin_run(const Stack&, std::size_t, std::size_t) noexcept
+	{
+
+	}
+
+	template <class Stack>
+	inline internal::merge_action next_merge(const Stack& stack) const noexcept
+	{
+		const auto run_count = stack.run_count();
+		if(((run_count > 2) and stack.merge_ABC_case_1())
+		   or ((run_count > 3) and stack.merge_ABC_case_2()))
+		{
+			if(stack.merge_AB())
+				return internal::merge_action::merge_AB;
+			else
+				return internal::merge_action::merge_BC;
+		}
+		else if((run_count > 1) and stack.merge_BC())
+			return internal::merge_action::merge_BC;
+		else
+			return internal::merge_action::none;
+	}
+
+	template <class Stack>
+	inline void end_run(const Stack&) noexcept
+	{
+
+	}
+};
+
+/**
+ * The Powersort merge pattern (Munro & Wild, 2018), which CPython's
+ * list.sort() has used since 3.11.
+ *
+ * Each boundary between two adjacent runs is assigned a 'power': the depth
+ * at which the boundary would sit in a perfectly balanced binary merge tree
+ * over the whole range, computed from the midpoints of the two runs.  The
+ * runs on the stack always have strictly increasing boundary powers, and
+ * whenever a new boundary is found, runs above any boundary with a higher
+ * power are merged first.  The resulting merge tree is provably within a
+ * small constant of the optimal one for the run lengths found, which
+ * avoids the unbalanced merges the classic rules can produce for some
+ * patterns of run lengths.
+ *
+ * For more details see:
+ * https://github.com/python/cpython/blob/main/Objects/listsort.txt
+ */
+struct powersort_merge_policy
+{
+	template <class Stack>
+	inline void begin_run(const Stack& stack, std::size_t n, std::size_t next_run_end) noexcept
+	{
+		const std::size_t run_begin = stack.template get_offset<1>();
+		const std::size_t run_end = stack.template get_offset<0>();
+		pending_power = node_power(run_begin, run_end - run_begin, next_run_end - run_end, n);
+	}
+
+	template <class Stack>
+	inline internal::merge_action next_merge(const Stack& stack) const noexcept
+	{
+		const auto run_count = stack.run_count();
+		if((run_count > 1) and (powers[run_count - 2] > pending_power))
+			return internal::merge_action::merge_BC;
+		return internal::merge_action::none;
+	}
+
+	template <class Stack>
+	inline void end_run(const Stack& stack) noexcept
+	{
+		powers[stack.run_count() - 1] = pending_power;
+	}
+
+	/**
+	 * @brief Power of the boundary between the run [s1, s1 + n1) and
+	 *        the run [s1 + n1, s1 + n1 + n2) in a range of length 'n'.
+	 *
+	 * This is the number of leading bits that the binary expansions of
+	 * the two runs' midpoints (as fractions of 'n') have in common, plus
+	 * one.  Same as powerloop() in CPython's listobject.c.
+	 */
+	static constexpr std::uint_least8_t node_power(std::size_t s1, std::size_t n1, std::size_t n2, std::size_t n) noexcept
+	{
+		std::uint_least8_t result = 0;
+		// 'a' and 'b' are twice the midpoints of the two runs
+		std::size_t a = 2 * s1 + n1;
+		std::size_t b = a + n1 + n2;
+		for(;;)
+		{
+			++result;
+			if(a >= n)
+			{
+				// both quotient bits are 1
+				a -= n;
+				b -= n;
+			}
+			else if(b >= n)
+			{
+				// a/n bit is 0 and b/n bit is 1
+				break;
+			}
+			a <<= 1;
+			b <<= 1;
+		}
+		return result;
+	}
+
+	/** Power of the boundary between the run at the top of the stack and the one being pushed. */
+	std::uint_least8_t pending_power = 0;
+	/** powers[i] is the power of the boundary between the ith and (i + 1)th runs. */
+	std::uint_least8_t powers[internal::timsort_max_stack_size<std::size_t>()];
+};
+
+
+} /* namespace tim */
+
+#endif /* TIMSORT_MERGE_POLICY_H */
@@ -0,0 +1,455 @@
+#ifndef TIMSORT_PARALLEL_TIMSORT_H
+#define TIMSORT_PARALLEL_TIMSORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+#ifdef __has_include
+# if __has_include(<execution>)
+#  include <execution>
+# endif
+#endif
+
+
+namespace tim {
+
+/**
+ * Default executor for the parallel timsort() overloads.
+ *
+ * An executor is any object 'ex' for which:
+ * 	ex.concurrency()  returns the number of tasks it can usefully run
+ * 	                  at the same time, and
+ * 	ex(count, task)   invokes task(0), ..., task(count - 1), possibly
+ * 	                  concurrently, and returns once all of them have
+ * 	                  finished.  If any task throws, one of the
+ * 	                  exceptions is rethrown after all tasks have
+ * 	                  finished.
+ *
+ * thread_executor implements this by spawning a fresh set of std::threads
+ * for every batch of tasks.  Wrap your own thread pool in a type with the
+ * same two members to avoid the thread start-up cost.
+ */
+struct thread_executor
+{
+	explicit thread_executor(std::size_t thread_count = std::thread::hardware_concurrency()) noexcept:
+		thread_count_(thread_count > 0 ? thread_count : 1)
+	{
+
+	}
+
+	std::size_t concurrency() const noexcept
+	{
+		return thread_count_;
+	}
+
+	template <class Task>
+	void operator()(std::size_t count, Task&& task) const
+	{
+		std::atomic<std::size_t> next{0};
+		std::exception_ptr error;
+		std::mutex error_mutex;
+		auto worker = [&]() {
+			for(auto i = next++; i < count; i = next++)
+			{
+				try
+				{
+					task(i);
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if(not error)
+						error = std::current_exception();
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		const std::size_t nthreads = std::min(count, thread_count_);
+		threads.reserve(nthreads - (nthreads > 0));
+		try
+		{
+			for(std::size_t i = 1; i < nthreads; ++i)
+				threads.emplace_back(worker);
+		}
+		catch(...)
+		{
+			// couldn't start another thread.  the ones we have (and
+			// this one) will pick up the slack.
+		}
+		worker();
+		for(auto& thread: threads)
+			thread.join();
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	std::size_t thread_count_;
+};
+
+/**
+ * Execution policy for the parallel timsort() overloads.  Holds the
+ * executor that the chunk sorts and merges are handed to.
+ *
+ * 	tim::timsort(tim::parallel_policy(tim::thread_executor(8)), v.begin(), v.end());
+ */
+template <class Executor = thread_executor>
+struct parallel_policy
+{
+	parallel_policy() = default;
+
+	explicit parallel_policy(Executor ex):
+		executor(std::move(ex))
+	{
+
+	}
+
+	Executor executor;
+};
+
+template <class Executor>
+parallel_policy(Executor) -> parallel_policy<Executor>;
+
+
+namespace internal {
+
+/**
+ * Minimum number of elements each task should get.  Below this, the
+ * cost of handing work off to other threads outweighs the gain.
+ */
+inline constexpr const std::size_t parallel_min_chunk = std::size_t(1) << 14;
+
+/**
+ * @brief Number of elements taken from [a, a + alen) among the first 'k'
+ *        elements of the stable merge of [a, a + alen) and [b, b + blen).
+ *
+ * Elements of 'a' are ordered before equivalent elements of 'b', which is
+ * what makes merging the pieces independently equivalent to one stable
+ * merge.
+ */
+template <class It, class Comp>
+std::size_t merge_split_point(It a, std::size_t alen, It b, std::size_t blen, std::size_t k, Comp comp)
+{
+	std::size_t lo = k > blen ? k - blen : 0;
+	std::size_t hi = std::min(k, alen);
+	while(lo < hi)
+	{
+		const std::size_t i = lo + (hi - lo) / 2;
+		if(not comp(b[k - i - 1], a[i]))
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return lo;
+}
+
+/**
+ * Output iterator that move-constructs into uninitialized storage and
+ * keeps count of how many objects it has constructed so far.  Its
+ * value_type is 'T' rather than void so that the merge's checks for
+ * memcpy()-able iterators can look at it.
+ */
+template <class T>
+struct constructing_iterator
+{
+	using iterator_category = std::output_iterator_tag;
+	using value_type = T;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = void;
+
+	constructing_iterator& operator*() noexcept { return *this; }
+	constructing_iterator& operator++() noexcept { return *this; }
+	constructing_iterator& operator++(int) noexcept { return *this; }
+
+	template <class U>
+	constructing_iterator& operator=(U&& value)
+	{
+		::new(static_cast<void*>(pos)) T(std::forward<U>(value));
+		++pos;
+		++*count;
+		return *this;
+	}
+
+	T* pos;
+	std::size_t* count;
+};
+
+/**
+ * Uninitialized, heap-allocated storage for 'n' objects used as the
+ * other half of the ping-pong buffer in the merge tree.  Destroys
+ * whatever it has been told was constructed in it.
+ */
+template <class T>
+struct parallel_merge_buffer
+{
+	explicit parallel_merge_buffer(std::size_t n):
+		data(std::allocator<T>().allocate(n)),
+		size(n)
+	{
+
+	}
+
+	~parallel_merge_buffer()
+	{
+		if constexpr(not std::is_trivially_destructible_v<T>)
+		{
+			for(const auto& [first, count]: constructed)
+				std::destroy(data + first, data + first + count);
+		}
+		std::allocator<T>().deallocate(data, size);
+	}
+
+	parallel_merge_buffer(const parallel_merge_buffer&) = delete;
+	parallel_merge_buffer& operator=(const parallel_merge_buffer&) = delete;
+
+	T* const data;
+	const std::size_t size;
+	/**
+	 * (offset, count) pairs describing the constructed portions of
+	 * 'data'.  Only meaningful for non-trivially-destructible types.
+	 */
+	std::vector<std::pair<std::size_t, std::size_t>> constructed;
+};
+
+/**
+ * One unit of work in a round of the merge tree: stably merge the source
+ * slices [a0, a1) and [b0, b1) into the destination starting at 'dest'.
+ * All offsets are relative to the start of the range being sorted.
+ */
+struct merge_task
+{
+	std::size_t a0;
+	std::size_t a1;
+	std::size_t b0;
+	std::size_t b1;
+	std::size_t dest;
+};
+
+/**
+ * Do 'task', moving the merged elements from 'src' to 'dest', with the
+ * serial sort's galloping merge.  Pieces that are already in order cost
+ * a gallop and a copy.  See TimSort::merge_into().
+ */
+template <class Src, class Dest, class Comp>
+Dest run_merge_task(const merge_task& task, Src src, Dest dest, Comp comp)
+{
+	TimSort<Src, Comp> merger(src + task.a0, src + task.b1, comp);
+	return merger.merge_into(src + task.a0, src + task.a1, src + task.b0, src + task.b1, dest);
+}
+
+/**
+ * Split every pair of adjacent runs in 'src' described by 'bounds' into
+ * roughly 'concurrency' equally-sized tasks.  A trailing unpaired run is
+ * turned into tasks that just move it across.
+ *
+ * The split points are all found up front: a task's binary search would
+ * otherwise read elements that a neighbouring task is busy moving from.
+ */
+template <class Src, class Comp>
+std::vector<merge_task> make_merge_tasks(Src src, const std::vector<std::size_t>& bounds, std::size_t concurrency, Comp comp)
+{
+	const std::size_t runs = bounds.size() - 1;
+	const std::size_t groups = (runs + 1) / 2;
+	const std::size_t pieces = std::max(std::size_t(1), concurrency / groups);
+	std::vector<merge_task> tasks;
+	tasks.reserve(groups * pieces);
+	for(std::size_t r = 0; r < runs; r += 2)
+	{
+		const std::size_t first = bounds[r];
+		const std::size_t mid = bounds[r + 1];
+		const std::size_t last = (r + 2 < bounds.size()) ? bounds[r + 2] : mid;
+		const std::size_t alen = mid - first;
+		const std::size_t blen = last - mid;
+		const std::size_t len = last - first;
+		std::size_t k0 = 0;
+		std::size_t i0 = 0;
+		for(std::size_t p = 1; p <= pieces; ++p)
+		{
+			const std::size_t k1 = (len * p) / pieces;
+			if(k1 == k0)
+				continue;
+			const std::size_t i1 = merge_split_point(src + first, alen, src + mid, blen, k1, comp);
+			tasks.push_back(merge_task{first + i0, first + i1, mid + (k0 - i0), mid + (k1 - i1), first + k0});
+			k0 = k1;
+			i0 = i1;
+		}
+	}
+	return tasks;
+}
+
+/**
+ * Update the run boundaries after a round of the merge tree has merged
+ * every pair of adjacent runs.
+ */
+inline void drop_merged_bounds(std::vector<std::size_t>& bounds)
+{
+	const std::size_t last = bounds.back();
+	std::size_t kept = 0;
+	for(std::size_t i = 0; i < bounds.size(); i += 2)
+		bounds[kept++] = bounds[i];
+	if(bounds[kept - 1] != last)
+		bounds[kept++] = last;
+	bounds.resize(kept);
+}
+
+template <class MergePolicy, class Executor, class It, class Comp>
+void parallel_timsort(const Executor& executor, It begin, It end, Comp comp)
+{
+	using value_type = iterator_value_type_t<It>;
+	const std::size_t len = end - begin;
+	const std::size_t concurrency = std::max(std::size_t(1), std::size_t(executor.concurrency()));
+	const std::size_t chunks = std::min(concurrency, len / parallel_min_chunk);
+	if(chunks < 2)
+	{
+		_timsort<MergePolicy>(begin, end, comp);
+		return;
+	}
+
+	// sort each chunk independently.
+	std::vector<std::size_t> bounds(chunks + 1);
+	for(std::size_t i = 0; i <= chunks; ++i)
+		bounds[i] = (len * i) / chunks;
+	executor(chunks, [&](std::size_t i) {
+		_timsort<MergePolicy>(begin + bounds[i], begin + bounds[i + 1], comp);
+	});
+
+	// if the chunks are already in order relative to each other, we're
+	// done.  this makes presorted input nearly free.
+	bool in_order = true;
+	for(std::size_t i = 1; in_order and i < chunks; ++i)
+		in_order = not comp(begin[bounds[i]], begin[bounds[i] - 1]);
+	if(in_order)
+		return;
+
+	// Merge adjacent runs pairwise, ping-ponging between the range and
+	// a buffer.  Each merge is split into independent pieces so that
+	// all of the executor's threads stay busy even in the last rounds
+	// where only one or two merges remain.  Each piece is merged like
+	// the serial sort merges runs, trimming what's already in place and
+	// galloping, so nearly ordered chunks cost little more than the
+	// copies.  Runs are only ever merged with their neighbours and ties
+	// always go to the left run, so the result is exactly as stable as
+	// the serial sort.
+	parallel_merge_buffer<value_type> buffer(len);
+	bool in_buffer = false;
+	{
+		// first round: construct into the uninitialized buffer
+		const auto tasks = make_merge_tasks(begin, bounds, concurrency, comp);
+		std::vector<std::size_t> counts(tasks.size(), 0);
+		try
+		{
+			executor(tasks.size(), [&](std::size_t i) {
+				const auto& task = tasks[i];
+				if constexpr(std::is_trivial_v<value_type>)
+				{
+					// nothing to construct, and the merge can memcpy()
+					run_merge_task(task, begin, buffer.data + task.dest, comp);
+				}
+				else
+				{
+					constructing_iterator<value_type> out{buffer.data + task.dest, &counts[i]};
+					run_merge_task(task, begin, out, comp);
+				}
+			});
+		}
+		catch(...)
+		{
+			if constexpr(not std::is_trivially_destructible_v<value_type>)
+				for(std::size_t i = 0; i < tasks.size(); ++i)
+					buffer.constructed.emplace_back(tasks[i].dest, counts[i]);
+			throw;
+		}
+		if constexpr(not std::is_trivially_destructible_v<value_type>)
+			buffer.constructed.emplace_back(0, len);
+		drop_merged_bounds(bounds);
+		in_buffer = true;
+	}
+	while(bounds.size() > 2)
+	{
+		const auto tasks = in_buffer ? make_merge_tasks(buffer.data, bounds, concurrency, comp)
+		                             : make_merge_tasks(begin, bounds, concurrency, comp);
+		executor(tasks.size(), [&](std::size_t i) {
+			const auto& task = tasks[i];
+			if(in_buffer)
+				run_merge_task(task, buffer.data, begin + task.dest, comp);
+			else
+				run_merge_task(task, begin, buffer.data + task.dest, comp);
+		});
+		drop_merged_bounds(bounds);
+		in_buffer = not in_buffer;
+	}
+	if(in_buffer)
+	{
+		const std::size_t pieces = std::min(concurrency, std::max(std::size_t(1), len / parallel_min_chunk));
+		executor(pieces, [&](std::size_t p) {
+			const std::size_t k0 = (len * p) / pieces;
+			const std::size_t k1 = (len * (p + 1)) / pieces;
+			move_or_memcpy(buffer.data + k0, buffer.data + k1, begin + k0);
+		});
+	}
+}
+
+} /* namespace internal */
+
+
+/**
+ * @brief Sort [begin, end) with the given executor.  Stable, with the same
+ *        guarantees as the serial timsort().
+ */
+template <class MergePolicy = timsort_merge_policy, class Executor, class It, class Comp>
+void timsort(const parallel_policy<Executor>& policy, It begin, It end, Comp comp)
+{
+	internal::parallel_timsort<MergePolicy>(policy.executor, begin, end, comp);
+}
+
+template <class MergePolicy = timsort_merge_policy, class Executor, class It>
+void timsort(const parallel_policy<Executor>& policy, It begin, It end)
+{
+	timsort<MergePolicy>(policy, begin, end, tim::internal::DefaultComparator{});
+}
+
+#if defined(__cpp_lib_execution) || defined(__cpp_lib_parallel_algorithm)
+
+/**
+ * @brief Sort [begin, end) according to a standard execution policy.
+ *
+ * std::execution::par and std::execution::par_unseq sort in parallel on
+ * std::thread::hardware_concurrency() threads.  Every other policy,
+ * including std::execution::unseq, sorts serially: those policies don't
+ * promise that the comparator may be called from several threads at once.
+ */
+template <class MergePolicy = timsort_merge_policy, class ExecutionPolicy, class It, class Comp>
+std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>>
+timsort(ExecutionPolicy&&, It begin, It end, Comp comp)
+{
+	using policy_type = std::decay_t<ExecutionPolicy>;
+	if constexpr(std::is_same_v<policy_type, std::execution::parallel_policy>
+		or std::is_same_v<policy_type, std::execution::parallel_unsequenced_policy>)
+		internal::parallel_timsort<MergePolicy>(thread_executor{}, begin, end, comp);
+	else
+		internal::_timsort<MergePolicy>(begin, end, comp);
+}
+
+template <class MergePolicy = timsort_merge_policy, class ExecutionPolicy, class It>
+std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>>
+timsort(ExecutionPolicy&& policy, It begin, It end)
+{
+	timsort<MergePolicy>(std::forward<ExecutionPolicy>(policy), begin, end, tim::internal::DefaultComparator{});
+}
+
+#endif
+
+} /* namespace tim */
+
+
+#endif /* TIMSORT_PARALLEL_TIMSORT_H */
@@ -0,0 +1,179 @@
+#ifndef TIMSORT_PROJECTION_H
+#define TIMSORT_PROJECTION_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+#include "argsort.h"
+
+
+namespace tim {
+namespace internal {
+
+template <class It, class Proj>
+using projected_t = std::invoke_result_t<Proj&, typename std::iterator_traits<It>::reference>;
+
+/**
+ * Compares two elements by comparing their projections.
+ */
+template <class Comp, class Proj>
+struct projected_comparator
+{
+	template <class Left, class Right>
+	inline bool operator()(Left&& left, Right&& right) const
+	{
+		return comp(std::invoke(proj, std::forward<Left>(left)),
+			    std::invoke(proj, std::forward<Right>(right)));
+	}
+
+	Comp comp;
+	Proj proj;
+};
+
+/**
+ * A cached sort key paired with the position of the element it came from.
+ * Trivially copyable whenever 'Key' is, so that sorting these gets the
+ * memcpy() fast paths.
+ */
+template <class Key, class Index = std::size_t>
+struct keyed_index
+{
+	Key key;
+	Index index;
+};
+
+/**
+ * How keys from 'Proj' are cached.  Keys are copied into the cache when
+ * they're small and trivially copyable, or when the projection returns
+ * them by value anyway.  Other keys returned by reference (e.g. a 
+ * std::string data member) are cached as a pointer to the key, since the 
+ * elements themselves don't move while the keys are sorted.
+ */
+template <class It, class Proj>
+struct key_cache_traits
+{
+	using projected_type = projected_t<It, Proj>;
+	using decayed_type = std::decay_t<projected_type>;
+	static constexpr const bool by_pointer = std::is_reference_v<projected_type>
+		and not (std::is_trivially_copyable_v<decayed_type> and sizeof(decayed_type) <= 2 * sizeof(void*));
+	using key_type = std::conditional_t<by_pointer,
+					    std::add_pointer_t<std::remove_reference_t<projected_type>>,
+					    decayed_type>;
+
+	static inline key_type make_key(Proj& proj, typename std::iterator_traits<It>::reference elem)
+	{
+		if constexpr(by_pointer)
+			return std::addressof(std::invoke(proj, elem));
+		else
+			return std::invoke(proj, elem);
+	}
+
+	static inline const auto& get_key(const key_type& key) noexcept
+	{
+		if constexpr(by_pointer)
+			return *key;
+		else
+			return key;
+	}
+};
+
+/**
+ * Whether timsort(begin, end, comp, proj) sorts cached keys and then moves
+ * each element once, instead of sorting the elements directly.
+ *
+ * Pays off when projecting is more than a member access (the projection
+ * returns a fresh value on every comparison), or when the elements are
+ * heavy enough that moving them around during merges costs more than
+ * sorting (key, index) pairs and one extra pass.
+ */
+template <class It, class Proj>
+inline constexpr const bool use_key_cache_v =
+	(not std::is_reference_v<projected_t<It, Proj>>)
+	or (sizeof(iterator_value_type_t<It>) > 4 * sizeof(void*));
+
+/**
+ * Presents the 'index' fields of an array of keyed_index as an array of
+ * indices, so they can be passed to apply_permutation().
+ */
+template <class Key, class Index>
+struct keyed_index_indices
+{
+	inline Index& operator[](std::size_t i) const noexcept
+	{
+		return keys[i].index;
+	}
+
+	keyed_index<Key, Index>* keys;
+};
+
+template <class Key, class Index>
+keyed_index_indices<Key, Index> indices_of(std::vector<keyed_index<Key, Index>>& keys) noexcept
+{
+	return keyed_index_indices<Key, Index>{keys.data()};
+}
+
+/**
+ * Decorate-sort-undecorate: compute every key once, stably sort the keys,
+ * then put the elements in place.
+ */
+template <class MergePolicy, class It, class Comp, class Proj>
+void timsort_cached_keys(It begin, It end, Comp comp, Proj proj)
+{
+	using traits = key_cache_traits<It, Proj>;
+	using key_type = typename traits::key_type;
+	const std::size_t count = end - begin;
+	std::vector<keyed_index<key_type>> keys;
+	keys.reserve(count);
+	for(std::size_t i = 0; i < count; ++i)
+		keys.push_back(keyed_index<key_type>{traits::make_key(proj, begin[i]), i});
+	_timsort<MergePolicy>(keys.begin(), keys.end(),
+		[comp](const auto& left, const auto& right) {
+			return comp(traits::get_key(left.key), traits::get_key(right.key));
+		}
+	);
+	apply_permutation(begin, end, indices_of(keys));
+}
+
+} /* namespace internal */
+
+
+/**
+ * @brief Stably sort the range [begin, end), comparing elements by
+ *        'comp(std::invoke(proj, a), std::invoke(proj, b))'.
+ *
+ * Like std::ranges::stable_sort(), 'proj' may be any invocable, including
+ * a pointer to a data member or to a member function.
+ *
+ * If the projection returns by value, or the elements are large, each key
+ * is computed only once: (key, index) pairs are sorted instead and the
+ * elements are then moved into place in a single pass.  This allocates a
+ * buffer of N (key, index) pairs.  Large keys returned by reference are cached
+ * as pointers.  Otherwise the elements are sorted directly and projected
+ * on every comparison.
+ */
+template <class MergePolicy = timsort_merge_policy,
+	  class It,
+	  class Comp,
+	  class Proj,
+	  class = std::enable_if_t<std::is_invocable_v<Proj&, typename std::iterator_traits<It>::reference>>>
+void timsort(It begin, It end, Comp comp, Proj proj)
+{
+	if constexpr(internal::use_key_cache_v<It, Proj>)
+	{
+		if((end - begin) > 1)
+			internal::timsort_cached_keys<MergePolicy>(begin, end, comp, proj);
+	}
+	else
+	{
+		internal::_timsort<MergePolicy>(begin, end, internal::projected_comparator<Comp, Proj>{comp, proj});
+	}
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_PROJECTION_H */
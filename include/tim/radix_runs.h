@@ -0,0 +1,150 @@
+#ifndef TIMSORT_RADIX_RUNS_H
+#define TIMSORT_RADIX_RUNS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "utils.h"
+
+namespace tim {
+namespace internal {
+
+#ifdef TIMSORT_NO_RADIX_RUNS
+inline constexpr const bool radix_runs_enabled = false;
+#else
+inline constexpr const bool radix_runs_enabled = true;
+#endif
+
+/**
+ * Whether stretches of random-looking 'T's ordered by 'Comp' are radix
+ * sorted into runs instead of being found and forced to minrun one
+ * comparison at a time.  Integers and IEEE floating point numbers with
+ * the builtin comparators only.
+ *
+ * Radix keys order floating point numbers totally, with -0.0 mapped to
+ * +0.0 so that the two stay in their original order, as they would with
+ * operator<.  NaNs end up at one end or the other (by sign bit), which is
+ * as good an answer as any since they don't have a strict weak ordering.
+ */
+template <class T, class Comp>
+inline constexpr const bool radix_sortable_v =
+	    radix_runs_enabled
+	and ((std::is_integral_v<T> and not std::is_same_v<T, bool>)
+	     or (std::is_floating_point_v<T> and std::numeric_limits<T>::is_iec559))
+	and (sizeof(T) <= sizeof(std::uint64_t))
+	and (is_builtin_ascending_comparator_v<T, Comp> or is_builtin_descending_comparator_v<T, Comp>);
+
+/**
+ * Number of elements radix sorted into each run.  Big enough to amortize
+ * the histograms, small enough to keep each pass in the L2 cache.
+ */
+inline constexpr const std::size_t radix_run_length = std::size_t(1) << 14;
+
+/**
+ * A stretch of 'radix_run_length' elements is radix sorted if the order
+ * of neighbouring elements turns (from ascending to descending or back)
+ * more often than once every 'radix_entropy_ratio' elements; roughly, if
+ * its natural runs are shorter than twice this on average.
+ */
+inline constexpr const std::size_t radix_entropy_ratio = 8;
+
+template <class T>
+using radix_key_t = std::conditional_t<sizeof(T) <= 1, std::uint8_t,
+		    std::conditional_t<sizeof(T) <= 2, std::uint16_t,
+		    std::conditional_t<sizeof(T) <= 4, std::uint32_t, std::uint64_t>>>;
+
+/**
+ * @brief Unsigned key for 'value' whose order matches that of 'value'
+ *        under operator< (or operator> if 'Descending').
+ */
+template <bool Descending, class T>
+inline radix_key_t<T> radix_key(T value) noexcept
+{
+	using key_type = radix_key_t<T>;
+	constexpr key_type sign_bit = key_type(1) << (std::numeric_limits<key_type>::digits - 1);
+	key_type key;
+	if constexpr(std::is_floating_point_v<T>)
+	{
+		std::memcpy(&key, &value, sizeof(key));
+		if(key == sign_bit)
+			key = 0;
+		key = (key & sign_bit) ? key_type(~key) : key_type(key | sign_bit);
+	}
+	else
+	{
+		key = static_cast<key_type>(value);
+		if constexpr(std::is_signed_v<T>)
+			key ^= sign_bit;
+	}
+	if constexpr(Descending)
+		key = key_type(~key);
+	return key;
+}
+
+/**
+ * @brief Number of times the order of neighbouring elements in 
+ *        [p, p + count) changes direction.
+ *
+ * Cheap stand-in for the number of natural runs (about half of this):
+ * strictly descending stretches count as presorted, just like ascending
+ * ones, and nothing depends on where the previous run ended.
+ */
+template <class It, class Comp>
+inline std::size_t count_run_turns(It p, std::size_t count, Comp comp)
+{
+	std::size_t turns = 0;
+	bool was_descending = comp(p[1], p[0]);
+	for(std::size_t i = 2; i < count; ++i)
+	{
+		const bool descending = comp(p[i], p[i - 1]);
+		turns += descending != was_descending;
+		was_descending = descending;
+	}
+	return turns;
+}
+
+/**
+ * @brief Stable LSD radix sort of [src, src + count), one byte per pass,
+ *        using [buffer, buffer + count) as the other half of each pass.
+ * @return Whichever of 'src' and 'buffer' holds the sorted elements.
+ *
+ * All the histograms are built up front, and passes over bytes that are
+ * the same in every key are skipped.
+ */
+template <bool Descending, class T>
+T* lsd_radix_sort(T* src, T* buffer, std::size_t count)
+{
+	using key_type = radix_key_t<T>;
+	constexpr std::size_t passes = sizeof(key_type);
+	std::size_t counts[passes][256] = {};
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const key_type key = radix_key<Descending>(src[i]);
+		for(std::size_t pass = 0; pass < passes; ++pass)
+			++counts[pass][(key >> (8 * pass)) & 0xff];
+	}
+	for(std::size_t pass = 0; pass < passes; ++pass)
+	{
+		const unsigned shift = 8 * pass;
+		if(counts[pass][(radix_key<Descending>(src[0]) >> shift) & 0xff] == count)
+			continue;
+		std::size_t offsets[256];
+		for(std::size_t digit = 0, total = 0; digit < 256; ++digit)
+		{
+			offsets[digit] = total;
+			total += counts[pass][digit];
+		}
+		for(std::size_t i = 0; i < count; ++i)
+			buffer[offsets[(radix_key<Descending>(src[i]) >> shift) & 0xff]++] = src[i];
+		std::swap(src, buffer);
+	}
+	return src;
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_RADIX_RUNS_H */
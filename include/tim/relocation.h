@@ -0,0 +1,153 @@
+#ifndef TIMSORT_RELOCATION_H
+#define TIMSORT_RELOCATION_H
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "contiguous_iterator.h"
+#include "memcpy_algos.h"
+#include "scratch_buffer.h"
+#include "small_sort.h"
+#include "iter.h"
+
+
+namespace tim {
+
+/**
+ * Whether a 'T' can be moved to another address by copying its bytes and
+ * then forgetting about the original, without running its destructor.
+ * That's true of most types that own something through a pointer, but
+ * not of types that point into themselves (like std::string's short
+ * string buffer in libstdc++) or that are pointed to by something else.
+ *
+ * True for trivially copyable types.  Specialize it for types of your own:
+ * 	template <>
+ * 	struct tim::is_trivially_relocatable<handle>: std::true_type {};
+ *
+ * timsort() sorts contiguous ranges of these as arrays of bytes when the
+ * comparison is noexcept, so that every move it makes is a memcpy() and
+ * no moved-from element is ever destroyed.  See README.md.
+ */
+template <class T>
+struct is_trivially_relocatable: std::is_trivially_copyable<T> {};
+
+template <class T>
+struct is_trivially_relocatable<std::unique_ptr<T, std::default_delete<T>>>: std::true_type {};
+
+template <class T>
+struct is_trivially_relocatable<std::shared_ptr<T>>: std::true_type {};
+
+template <class T>
+struct is_trivially_relocatable<std::weak_ptr<T>>: std::true_type {};
+
+template <class T, class U>
+struct is_trivially_relocatable<std::pair<T, U>>:
+	std::bool_constant<is_trivially_relocatable<T>::value and is_trivially_relocatable<U>::value> {};
+
+// three pointers in libstdc++ and libc++, unless their debug modes keep
+// track of containers by address
+#if (defined(__GLIBCXX__) and not defined(_GLIBCXX_DEBUG)) \
+	or (defined(_LIBCPP_VERSION) and not defined(_LIBCPP_DEBUG) and not defined(_LIBCPP_ENABLE_DEBUG_MODE))
+template <class T>
+struct is_trivially_relocatable<std::vector<T, std::allocator<T>>>: std::true_type {};
+#endif
+
+template <class T>
+inline constexpr const bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+
+namespace internal {
+
+/**
+ * Storage for the bytes of a 'T' that's being relocated.  Trivially
+ * copyable, so it gets all the memcpy() paths, and trivially destructible,
+ * so buffers of them never destroy anything.
+ */
+template <class T>
+struct alignas(T) relocatable_bytes
+{
+	unsigned char bytes[sizeof(T)];
+};
+
+/** Whether 'Scratch' allocates uninitialized memory for 'T's itself. */
+template <class Scratch, class T, class = void>
+struct is_allocator_scratch: std::false_type {};
+
+template <class Scratch, class T>
+struct is_allocator_scratch<Scratch, T, std::void_t<typename Scratch::allocator_type>>:
+	std::is_base_of<allocator_scratch<T, typename Scratch::allocator_type>, Scratch> {};
+
+/**
+ * Whether timsort() sorts [begin, end) as relocatable_bytes: the elements
+ * are trivially relocatable but not trivially copyable (those get the
+ * memcpy() paths already), the range is contiguous, the merge buffer is
+ * one timsort() allocates (a caller-supplied one holds live 'T's), 'comp'
+ * is noexcept, and there's no user-supplied small_sorter<T> to bypass.  A
+ * comparison that threw halfway through a merge would leave an element's
+ * bytes in two places and another's nowhere.
+ */
+template <class It, class Comp, class Scratch>
+inline constexpr const bool sort_by_relocation_v =
+	    is_trivially_relocatable_v<iterator_value_type_t<It>>
+	and (not std::is_trivially_copyable_v<iterator_value_type_t<It>>)
+	and is_contiguous_iterator_v<It>
+	and is_allocator_scratch<Scratch, iterator_value_type_t<It>>::value
+	and has_default_small_sorter_v<iterator_value_type_t<It>>
+	and std::is_nothrow_invocable_r_v<bool, const Comp&, const iterator_value_type_t<It>&, const iterator_value_type_t<It>&>;
+
+/**
+ * Scratch buffer for sorting relocatable_bytes<T>: the same as 'Base' (an
+ * allocator_scratch<T, Alloc> or one derived from it), but the bytes are
+ * copied into its memory without constructing any 'T's there.  So the
+ * merge buffer cache for 'T' works as usual.
+ */
+template <class Base>
+struct relocating_scratch: Base
+{
+	template <class It>
+	merge_buffer_iter_t<It, iterator_value_type_t<It>> fill(It begin, It end)
+	{
+		using bytes_type = iterator_value_type_t<It>;
+		return move_to_buffer(begin, end, reinterpret_cast<bytes_type*>(this->buffer));
+	}
+};
+
+template <class Base>
+void try_get_cached_heap_buffer(relocating_scratch<Base>& scratch) noexcept
+{
+	try_get_cached_heap_buffer(static_cast<Base&>(scratch));
+}
+
+template <class Base>
+void try_cache_heap_buffer(relocating_scratch<Base>& scratch) noexcept
+{
+	try_cache_heap_buffer(static_cast<Base&>(scratch));
+}
+
+/**
+ * Compares relocatable_bytes as the 'T's whose bytes they hold, with a
+ * noexcept 'Comp' (see sort_by_relocation_v).
+ */
+template <class T, class Comp>
+struct relocating_comparator
+{
+	inline bool operator()(const relocatable_bytes<T>& left, const relocatable_bytes<T>& right) const noexcept
+	{
+		return comp(*reinterpret_cast<const T*>(left.bytes), *reinterpret_cast<const T*>(right.bytes));
+	}
+
+	Comp comp;
+};
+
+template <class It>
+relocatable_bytes<iterator_value_type_t<It>>* as_relocatable_bytes(It iter) noexcept
+{
+	return reinterpret_cast<relocatable_bytes<iterator_value_type_t<It>>*>(get_memcpy_iterator(iter));
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_RELOCATION_H */
@@ -0,0 +1,264 @@
+#ifndef TIMSORT_RUN_ANALYSIS_H
+#define TIMSORT_RUN_ANALYSIS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include "timsort.h"
+
+
+namespace tim {
+
+/**
+ * How presorted a range is, as timsort() would see it.  Returned by
+ * analyze_runs() and analyze_runs_sampled().
+ *
+ * A natural run is what timsort() finds before forcing short runs to
+ * minrun: a non-descending stretch, or a strictly descending one (plus
+ * whatever continues it once it's reversed).
+ */
+struct run_analysis
+{
+	/** Number of elements in the range. */
+	std::size_t elements = 0;
+	/** Number of natural runs. */
+	std::size_t runs = 0;
+	/** Of those, how many started out strictly descending. */
+	std::size_t descending_runs = 0;
+	/** Length of the longest natural run. */
+	std::size_t longest_run = 0;
+	/** run_lengths[k] is the number of natural runs of length [2^k, 2^(k + 1)). */
+	std::size_t run_lengths[std::numeric_limits<std::size_t>::digits] = {};
+
+	/**
+	 * Entropy of the run lengths in bits: the sum over runs of
+	 * (length / elements) * log2(elements / length).  0 for sorted input,
+	 * about log2(elements) - 1.5 for random input.
+	 */
+	double entropy = 0.0;
+	/** Fraction of the elements that are in runs that started out strictly descending. */
+	double descending_fraction = 0.0;
+
+	/**
+	 * Rough number of comparisons timsort() would make: one per element to
+	 * find the runs, about log2(minrun) per element of short runs to force
+	 * them to minrun, and the entropy of the forced runs per element to
+	 * merge them.  That's about right for runs whose elements interleave,
+	 * but galloping makes merges of runs that hardly do much cheaper: a
+	 * sorted range with a few elements out of place takes several times
+	 * fewer.  Radix sorted stretches (see radix_runs.h) are left out too.
+	 */
+	double predicted_comparisons = 0.0;
+	/**
+	 * Rough number of element moves timsort() would make: minrun / 4 per
+	 * element of short runs to insertion sort them, one per element of
+	 * descending runs to reverse them, and the entropy of the forced runs
+	 * per element to merge them.
+	 */
+	double predicted_moves = 0.0;
+
+	/** Whether these are estimates from analyze_runs_sampled(). */
+	bool sampled = false;
+
+	/** Whether the range is (or, if sampled, looks) sorted already. */
+	bool sorted() const noexcept
+	{
+		return runs <= 1 and descending_runs == 0;
+	}
+};
+
+
+namespace internal {
+
+/*
+ * Adds up natural runs, each standing for 'count' runs of its length (more
+ * than one when the runs come from a sample), and works out a run_analysis.
+ */
+struct run_census
+{
+	explicit run_census(std::size_t minrun_length) noexcept:
+		minrun(minrun_length)
+	{
+
+	}
+
+	void add(std::size_t length, bool descending, double count = 1.0) noexcept
+	{
+		const double run_elements = count * double(length);
+		const double length_log = run_elements * std::log2(double(length));
+		runs += count;
+		elements += run_elements;
+		length_log_sum += length_log;
+		if(descending)
+		{
+			descending_runs += count;
+			descending_elements += run_elements;
+		}
+		if(length < minrun)
+			short_elements += run_elements;
+		else
+			long_length_log_sum += length_log;
+		longest = std::max(longest, length);
+		std::size_t log2_length = 0;
+		while(length >>= 1)
+			++log2_length;
+		lengths[log2_length] += count;
+	}
+
+	run_analysis finish(std::size_t element_count, bool sampled) const noexcept
+	{
+		run_analysis result;
+		result.elements = element_count;
+		result.sampled = sampled;
+		result.runs = std::size_t(std::llround(runs));
+		result.descending_runs = std::size_t(std::llround(descending_runs));
+		result.longest_run = longest;
+		for(std::size_t i = 0; i < std::size(lengths); ++i)
+			result.run_lengths[i] = std::size_t(std::llround(lengths[i]));
+		if(elements <= 0.0)
+			return result;
+		// sums are over 'elements', which is the range's size unless sampled
+		const double n = double(element_count);
+		const double log2_n = std::log2(n);
+		const double log2_minrun = std::log2(double(minrun));
+		result.entropy = std::max(log2_n - length_log_sum / elements, 0.0);
+		result.descending_fraction = descending_elements / elements;
+		// short runs get forced to minrun before they're merged
+		const double short_fraction = short_elements / elements;
+		const double forced_entropy = std::max(
+			log2_n - (long_length_log_sum + short_elements * log2_minrun) / elements, 0.0
+		);
+		result.predicted_comparisons = (n - 1) + n * (short_fraction * log2_minrun + forced_entropy);
+		result.predicted_moves = n * (short_fraction * double(minrun) / 4 + result.descending_fraction + forced_entropy);
+		return result;
+	}
+
+	std::size_t minrun;
+	double runs = 0.0;
+	double elements = 0.0;
+	double length_log_sum = 0.0;
+	double long_length_log_sum = 0.0;
+	double short_elements = 0.0;
+	double descending_runs = 0.0;
+	double descending_elements = 0.0;
+	double lengths[std::numeric_limits<std::size_t>::digits] = {};
+	std::size_t longest = 0;
+};
+
+} /* namespace internal */
+
+
+/**
+ * @brief Find the natural runs of [begin, end) with respect to 'comp' the
+ *        way timsort() would, without moving anything, and report how
+ *        presorted the range is.
+ *
+ * Makes one comparison per element (with the same vectorized scans as
+ * timsort() for builtin comparisons of arithmetic types), so it's much
+ * cheaper than the sort.  Useful for choosing between timsort(), an
+ * unstable sort, a radix sort or nothing at all, or for noticing when
+ * input that used to be presorted isn't anymore.
+ */
+template <class It, class Comp>
+run_analysis analyze_runs(It begin, It end, Comp comp)
+{
+	using value_type = internal::iterator_value_type_t<It>;
+	const std::size_t count = end - begin;
+	internal::run_census census(internal::compute_minrun<value_type>(count));
+	internal::TimSort<It, Comp> finder(begin, end, comp);
+	while(finder.position < finder.stop)
+	{
+		const auto [length, descending] = finder.measure_next_run();
+		census.add(length, descending);
+	}
+	return census.finish(count, false);
+}
+
+template <class It>
+run_analysis analyze_runs(It begin, It end)
+{
+	return analyze_runs(begin, end, tim::internal::DefaultComparator{});
+}
+
+/**
+ * @brief Estimate analyze_runs(begin, end, comp) from 'windows' evenly
+ *        spaced stretches of 'window_length' elements, in time that
+ *        doesn't depend on the length of the range.
+ *
+ * Runs that start and end inside a window are counted as they are,
+ * scaled up to the whole range.  The number of runs is estimated from how
+ * often runs end inside windows, and whatever runs that leaves unaccounted
+ * for are taken to be equally long and to cover the elements that the
+ * windows found in runs that cross their edges.  So the estimates are good
+ * for inputs that look alike throughout, like random data, data with runs
+ * that are all short, or sorted data, and rougher otherwise.  The result's
+ * longest_run is the longest run found in a window, or the estimated
+ * length of the runs crossing windows' edges if that's longer.  Ranges no
+ * longer than the windows put together are analyzed in full.
+ */
+template <class It, class Comp>
+run_analysis analyze_runs_sampled(It begin, It end, Comp comp, std::size_t windows = 64, std::size_t window_length = 1024)
+{
+	using value_type = internal::iterator_value_type_t<It>;
+	const std::size_t count = end - begin;
+	window_length = std::max<std::size_t>(window_length, 2);
+	if(windows == 0 or count / windows <= window_length)
+		return analyze_runs(begin, end, comp);
+
+	internal::run_census census(internal::compute_minrun<value_type>(count));
+	const double scale = double(count) / double(windows * window_length);
+	// runs ending inside windows, and elements and descending elements in
+	// runs that cross windows' edges
+	std::size_t run_ends = 0;
+	std::size_t crossing_elements = 0;
+	std::size_t crossing_descending = 0;
+	std::size_t longest_crossing = 0;
+	for(std::size_t i = 0; i < windows; ++i)
+	{
+		const It window = begin + (count / windows) * i;
+		internal::TimSort<It, Comp> finder(window, window + window_length, comp);
+		while(finder.position < finder.stop)
+		{
+			const It run = finder.position;
+			const auto [length, descending] = finder.measure_next_run();
+			if(finder.position < finder.stop)
+				++run_ends;
+			if(run == window or finder.position == finder.stop)
+			{
+				crossing_elements += length;
+				crossing_descending += descending ? length : 0;
+				longest_crossing = std::max(longest_crossing, length);
+			}
+			else
+			{
+				census.add(length, descending, scale);
+			}
+		}
+	}
+	if(crossing_elements > 0)
+	{
+		const double pairs = double(windows * (window_length - 1));
+		const double runs = 1.0 + double(run_ends) * double(count - 1) / pairs;
+		const double crossing_runs = std::max(runs - census.runs, 1.0);
+		const double crossing_length = std::min(double(crossing_elements) * scale / crossing_runs, double(count));
+		const std::size_t length = std::max<std::size_t>(std::llround(crossing_length), 1);
+		// split them into descending and not as the windows found them
+		const double descending_share = double(crossing_descending) / double(crossing_elements);
+		census.add(length, true, crossing_runs * descending_share);
+		census.add(length, false, crossing_runs * (1.0 - descending_share));
+	}
+	census.longest = std::max(census.longest, longest_crossing);
+	return census.finish(count, true);
+}
+
+template <class It>
+run_analysis analyze_runs_sampled(It begin, It end)
+{
+	return analyze_runs_sampled(begin, end, tim::internal::DefaultComparator{});
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_RUN_ANALYSIS_H */
@@ -0,0 +1,157 @@
+#ifndef TIMSORT_RUN_VECTOR_H
+#define TIMSORT_RUN_VECTOR_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+
+
+namespace tim {
+
+/**
+ * @brief A vector that is appended to in any order and read in sorted
+ *        (stable) order.
+ *
+ * Appended elements are pending until the next read.  A read sorts only
+ * the pending elements, finding runs in them as timsort() would, and then
+ * merges them with the already-sorted prefix, which is pushed on to the
+ * run stack as a single known run instead of being scanned again.  The
+ * final merge gallops past the parts of the prefix that stay put, so
+ * reading after appending k elements to a sorted vector of n costs about
+ * O(k log(k) + k log(n / k)) comparisons rather than a full re-sort.
+ *
+ * Equal elements read back in the order they were appended.
+ *
+ * The pending elements are sorted lazily, so the read accessors are const
+ * but may still modify the vector's storage: concurrent reads of one
+ * run_vector need external synchronization, as writes would.
+ */
+template <class T, class Comp = std::less<>, class MergePolicy = timsort_merge_policy>
+class run_vector
+{
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using const_reference = const T&;
+	using const_iterator = typename std::vector<T>::const_iterator;
+	using comparator_type = Comp;
+
+	run_vector() = default;
+
+	explicit run_vector(Comp comp_func):
+		comp(std::move(comp_func))
+	{
+
+	}
+
+	template <class InputIt>
+	run_vector(InputIt first, InputIt last, Comp comp_func = Comp{}):
+		elements(first, last),
+		comp(std::move(comp_func))
+	{
+
+	}
+
+	void push_back(const T& value)
+	{
+		elements.push_back(value);
+	}
+
+	void push_back(T&& value)
+	{
+		elements.push_back(std::move(value));
+	}
+
+	template <class ... Args>
+	void emplace_back(Args&& ... args)
+	{
+		elements.emplace_back(std::forward<Args>(args)...);
+	}
+
+	template <class InputIt>
+	void append(InputIt first, InputIt last)
+	{
+		elements.insert(elements.end(), first, last);
+	}
+
+	void reserve(size_type count)
+	{
+		elements.reserve(count);
+	}
+
+	void clear() noexcept
+	{
+		elements.clear();
+		sorted_count = 0;
+	}
+
+	size_type size() const noexcept
+	{
+		return elements.size();
+	}
+
+	bool empty() const noexcept
+	{
+		return elements.empty();
+	}
+
+	/** Number of elements appended since the last read. */
+	size_type pending() const noexcept
+	{
+		return elements.size() - sorted_count;
+	}
+
+	/** @brief All of the elements, in sorted order. */
+	const std::vector<T>& sorted() const
+	{
+		if(pending() > 0)
+			merge_pending();
+		return elements;
+	}
+
+	const_iterator begin() const
+	{
+		return sorted().begin();
+	}
+
+	const_iterator end() const
+	{
+		return sorted().end();
+	}
+
+	const_reference operator[](size_type index) const
+	{
+		return sorted()[index];
+	}
+
+	/** @brief Take the sorted elements out, leaving this empty. */
+	std::vector<T> release()
+	{
+		sorted();
+		sorted_count = 0;
+		return std::move(elements);
+	}
+
+private:
+	void merge_pending() const
+	{
+		using iterator = typename std::vector<T>::iterator;
+		if(sorted_count == 0)
+			internal::_timsort<MergePolicy>(elements.begin(), elements.end(), comp);
+		else
+			internal::TimSort<iterator, Comp, MergePolicy>(elements.begin(), elements.end(), comp).sort(sorted_count);
+		sorted_count = elements.size();
+	}
+
+	/** Appended elements; [0, sorted_count) of them are sorted. */
+	mutable std::vector<T> elements;
+	mutable size_type sorted_count = 0;
+	Comp comp;
+};
+
+} /* namespace tim */
+
+#endif /* TIMSORT_RUN_VECTOR_H */
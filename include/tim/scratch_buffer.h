@@ -0,0 +1,434 @@
+#ifndef TIMSORT_SCRATCH_BUFFER_H
+#define TIMSORT_SCRATCH_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "memcpy_algos.h"
+#include "iter.h"
+
+
+namespace tim {
+
+/**
+ * Non-owning view of a caller-supplied array of 'T' to be used as the merge
+ * buffer by timsort().  The objects in the array must be alive; elements
+ * being merged are move-assigned into it, so after the sort its contents
+ * are valid, but unspecified.  For trivially copyable types this is just a
+ * block of raw memory.
+ *
+ * Constructible from a pointer and a size, from a built-in array, or from
+ * any contiguous container with data() and size() members (std::vector,
+ * std::array, std::span, ...).
+ */
+template <class T>
+struct scratch_span
+{
+	constexpr scratch_span() noexcept = default;
+
+	constexpr scratch_span(T* data, std::size_t size) noexcept:
+		data_(data), size_(size)
+	{
+
+	}
+
+	template <std::size_t N>
+	constexpr scratch_span(T (&array)[N]) noexcept:
+		data_(array), size_(N)
+	{
+
+	}
+
+	template <class Container,
+		  class = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+	constexpr scratch_span(Container& container) noexcept(noexcept(container.data()) and noexcept(container.size())):
+		data_(container.data()), size_(container.size())
+	{
+
+	}
+
+	constexpr T* data() const noexcept
+	{
+		return data_;
+	}
+
+	constexpr std::size_t size() const noexcept
+	{
+		return size_;
+	}
+
+private:
+	T* data_ = nullptr;
+	std::size_t size_ = 0;
+};
+
+template <class T, std::size_t N>
+scratch_span(T (&)[N]) -> scratch_span<T>;
+
+template <class Container>
+scratch_span(Container&) -> scratch_span<std::remove_pointer_t<decltype(std::declval<Container&>().data())>>;
+
+/**
+ * @brief Number of elements a scratch_span must hold for timsort() to
+ *        never have to fall back to merging without a buffer when sorting
+ *        'n' elements.
+ *
+ * A merge only ever needs to buffer the smaller of the two runs being
+ * merged, which is never more than half of the range.
+ */
+constexpr std::size_t scratch_elements_needed(std::size_t n) noexcept
+{
+	return n / 2;
+}
+
+
+namespace internal {
+
+/**
+ * Type of iterator the merge routine uses to read back a run that was
+ * moved into a merge buffer of 'T's from [begin, end).  Runs iterated
+ * in reverse over contiguous memory are memcpy()'d in as-is, so they
+ * have to be read back in reverse too.
+ */
+template <class It, class T>
+using merge_buffer_iter_t = std::conditional_t<(not can_forward_memcpy_v<It>) and can_reverse_memcpy_v<It>,
+					       std::reverse_iterator<T*>,
+					       T*>;
+
+/**
+ * @brief Move [begin, end) into the array of live 'T's at 'buffer'.
+ * @return Iterator to the first element of the run in the buffer.
+ */
+template <class T, class It>
+merge_buffer_iter_t<It, T> move_to_buffer(It begin, It end, T* buffer)
+{
+	const std::size_t count = end - begin;
+	if constexpr(can_forward_memcpy_v<It>)
+	{
+		std::memcpy(buffer, get_memcpy_iterator(begin), count * sizeof(T));
+		return buffer;
+	}
+	else if constexpr(can_reverse_memcpy_v<It>)
+	{
+		std::memcpy(buffer, get_memcpy_iterator(end - 1), count * sizeof(T));
+		return std::make_reverse_iterator(buffer + count);
+	}
+	else
+	{
+		std::move(begin, end, buffer);
+		return buffer;
+	}
+}
+
+/*
+ * SCRATCH BUFFERS
+ *
+ * A scratch buffer supplies the merge buffer whenever the stack buffer is
+ * too small.  Scratch buffer types provide:
+ *
+ * 	is_bounded       Whether reserve() can fail.  When it can, merges
+ * 	                 that don't fit are split with rotations instead.
+ * 	reserve(n)       Make room for 'n' elements.  Returns false if that's
+ * 	                 not possible.
+ * 	fill(begin, end) Move [begin, end) into the buffer, which reserve()
+ * 	                 has made room for, and return an iterator to the
+ * 	                 first element (see merge_buffer_iter_t).
+ * 	clear()          Called after each merge.
+ */
+
+/**
+ * Scratch buffer in uninitialized memory from an 'Alloc' (rebound to 'T').
+ * reserve() throws whatever the allocator throws if allocation fails.
+ *
+ * Only the allocator's allocate() and deallocate() are used: elements are
+ * memcpy()'d in when they can be, and move constructed in with placement
+ * new (not the allocator's construct()) otherwise, so nothing is ever
+ * zeroed or value-initialized first, and a std::pmr::polymorphic_allocator
+ * doesn't make moves of allocator-aware elements into copies.
+ */
+template <class T, class Alloc = std::allocator<T>>
+struct allocator_scratch
+{
+	using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+	using allocator_traits = std::allocator_traits<allocator_type>;
+	static_assert(std::is_same_v<typename allocator_traits::pointer, T*>,
+		      "allocator_scratch needs an allocator whose pointers are plain pointers.");
+
+	static constexpr const bool is_bounded = false;
+
+	allocator_scratch() = default;
+
+	explicit allocator_scratch(const allocator_type& alloc) noexcept:
+		allocator(alloc)
+	{
+
+	}
+
+	allocator_scratch(allocator_scratch&& other) noexcept:
+		allocator(other.allocator),
+		buffer(std::exchange(other.buffer, nullptr)),
+		capacity(std::exchange(other.capacity, 0)),
+		constructed(std::exchange(other.constructed, 0))
+	{
+
+	}
+
+	allocator_scratch(const allocator_scratch&) = delete;
+	allocator_scratch& operator=(const allocator_scratch&) = delete;
+	allocator_scratch& operator=(allocator_scratch&&) = delete;
+
+	~allocator_scratch()
+	{
+		clear();
+		deallocate();
+	}
+
+	inline bool reserve(std::size_t n)
+	{
+		// nothing to copy over: the buffer is always empty between merges
+		if(n > capacity)
+		{
+			// std::allocator gets memory back, so it gets exactly what's
+			// needed.  others (arenas, say) may not, so grow geometrically
+			// so that the total is less than four times the largest merge.
+			const std::size_t size = std::is_same_v<allocator_type, std::allocator<T>> ? n : std::max(n, 2 * capacity);
+			deallocate();
+			buffer = allocator_traits::allocate(allocator, size);
+			capacity = size;
+		}
+		return true;
+	}
+
+	template <class It>
+	merge_buffer_iter_t<It, T> fill(It begin, It end)
+	{
+		if constexpr(can_forward_memcpy_v<It> or can_reverse_memcpy_v<It>)
+		{
+			// memcpy() it if we can
+			return move_to_buffer(begin, end, buffer);
+		}
+		else
+		{
+			std::uninitialized_move(begin, end, buffer);
+			constructed = end - begin;
+			return buffer;
+		}
+	}
+
+	inline void clear() noexcept
+	{
+		// destroy whatever was moved in while the buffer is still
+		// hot (possibly cached)
+		std::destroy_n(buffer, constructed);
+		constructed = 0;
+	}
+
+	inline void deallocate() noexcept
+	{
+		if(buffer)
+			allocator_traits::deallocate(allocator, buffer, capacity);
+		buffer = nullptr;
+		capacity = 0;
+	}
+
+	allocator_type allocator;
+	T* buffer = nullptr;
+	std::size_t capacity = 0;
+	/** Number of live objects at the start of 'buffer'. */
+	std::size_t constructed = 0;
+};
+
+/**
+ * Default scratch buffer: uninitialized memory from std::allocator<T>,
+ * which can be kept in the thread's merge buffer cache between sorts.
+ */
+template <class T>
+struct heap_scratch: allocator_scratch<T>
+{
+
+};
+
+/**
+ * Heap scratch buffer for tim::stable_sort().  Same as heap_scratch, but
+ * reserve() reports allocation failure instead of throwing, so that only
+ * the merges that can't get memory fall back to rotations.
+ */
+template <class T>
+struct nothrow_heap_scratch: heap_scratch<T>
+{
+	static constexpr const bool is_bounded = true;
+
+	inline bool reserve(std::size_t n) noexcept
+	{
+		try
+		{
+			return allocator_scratch<T>::reserve(n);
+		}
+		catch(const std::bad_alloc&)
+		{
+			return false;
+		}
+	}
+};
+
+/**
+ * Scratch buffer wrapping a caller-supplied scratch_span.  Never allocates.
+ */
+template <class T>
+struct span_scratch
+{
+	static constexpr const bool is_bounded = true;
+
+	explicit span_scratch(scratch_span<T> span) noexcept:
+		span(span)
+	{
+
+	}
+
+	inline bool reserve(std::size_t n) const noexcept
+	{
+		return n <= span.size();
+	}
+
+	template <class It>
+	merge_buffer_iter_t<It, T> fill(It begin, It end)
+	{
+		return move_to_buffer(begin, end, span.data());
+	}
+
+	inline void clear() const noexcept
+	{
+
+	}
+
+	scratch_span<T> span;
+};
+
+/**
+ * A thread's cached merge buffer for 'T's: 'capacity' elements' worth of
+ * memory from std::allocator<T>, which never holds any live objects.
+ */
+template <class T>
+struct merge_buffer_cache
+{
+	~merge_buffer_cache()
+	{
+		release();
+	}
+
+	void release() noexcept
+	{
+		if(buffer)
+			std::allocator<T>().deallocate(buffer, capacity);
+		buffer = nullptr;
+		capacity = 0;
+	}
+
+	T* buffer = nullptr;
+	std::size_t capacity = 0;
+	std::size_t limit = 0;
+};
+
+template <class T>
+merge_buffer_cache<T>& thread_merge_buffer_cache() noexcept
+{
+	static thread_local merge_buffer_cache<T> cache;
+	return cache;
+}
+
+/**
+ * @brief Hand this thread's cached merge buffer (if any) over to 'scratch'.
+ */
+template <class T>
+void try_get_cached_heap_buffer(heap_scratch<T>& scratch) noexcept
+{
+	auto& cache = thread_merge_buffer_cache<T>();
+	if(cache.limit > 0)
+	{
+		std::swap(scratch.buffer, cache.buffer);
+		std::swap(scratch.capacity, cache.capacity);
+	}
+}
+
+/**
+ * @brief Keep the memory in 'scratch' for the next sort on this thread if
+ *        it isn't over the limit and is bigger than what's cached already.
+ */
+template <class T>
+void try_cache_heap_buffer(heap_scratch<T>& scratch) noexcept
+{
+	auto& cache = thread_merge_buffer_cache<T>();
+	if(scratch.capacity <= cache.limit and scratch.capacity > cache.capacity)
+	{
+		std::swap(scratch.buffer, cache.buffer);
+		std::swap(scratch.capacity, cache.capacity);
+	}
+}
+
+template <class T>
+void try_get_cached_heap_buffer(nothrow_heap_scratch<T>& scratch) noexcept
+{
+	try_get_cached_heap_buffer(static_cast<heap_scratch<T>&>(scratch));
+}
+
+template <class T>
+void try_cache_heap_buffer(nothrow_heap_scratch<T>& scratch) noexcept
+{
+	try_cache_heap_buffer(static_cast<heap_scratch<T>&>(scratch));
+}
+
+/* Other scratch buffers don't own any memory worth caching. */
+template <class Scratch>
+void try_get_cached_heap_buffer(Scratch&) noexcept
+{
+
+}
+
+template <class Scratch>
+void try_cache_heap_buffer(Scratch&) noexcept
+{
+
+}
+
+} /* namespace internal */
+
+/**
+ * @brief Let timsort() keep the merge buffer it allocates when sorting 'T's
+ *        on the calling thread and reuse it in the next sort of 'T's on
+ *        that thread.
+ * @param max_elements  Largest buffer to keep, in elements.  Zero (the 
+ *                      default) disables the cache.
+ *
+ * The limit is per-thread and per-type.  A cached buffer is only ever
+ * memory, never objects, and is freed when the thread exits.  Lowering the
+ * limit below the size of the currently cached buffer frees it.  If a sort
+ * exits with an exception, the buffer it was using is freed.
+ */
+template <class T>
+void set_merge_buffer_cache_limit(std::size_t max_elements) noexcept
+{
+	auto& cache = internal::thread_merge_buffer_cache<T>();
+	cache.limit = max_elements;
+	if(cache.capacity > max_elements)
+		cache.release();
+}
+
+/**
+ * @brief Free the calling thread's cached merge buffer for 'T's, if any.
+ *        The limit set with set_merge_buffer_cache_limit() is unchanged.
+ */
+template <class T>
+void release_merge_buffer_cache() noexcept
+{
+	internal::thread_merge_buffer_cache<T>().release();
+}
+
+} /* namespace tim */
+
+
+#endif /* TIMSORT_SCRATCH_BUFFER_H */
@@ -0,0 +1,51 @@
+#ifndef TIMSORT_SIMD_H
+#define TIMSORT_SIMD_H
+
+#include "compiler.h"
+
+#ifdef COMPILER_X86_SIMD_
+# include <immintrin.h>
+#endif
+
+namespace tim {
+namespace internal {
+
+/**
+ * Vector instruction sets the vectorized code paths (see simd_merge.h and 
+ * simd_runs.h) know how to use.
+ */
+enum class simd_level
+{
+	none,
+	sse41,
+	avx2
+};
+
+/**
+ * @brief Best instruction set the CPU we're running on supports.  
+ *
+ * Always simd_level::none if the compiler can't target instruction sets 
+ * other than the one it was told to compile for.
+ */
+inline simd_level detect_simd_level() noexcept
+{
+#ifdef COMPILER_X86_SIMD_
+	static const simd_level level = []() {
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			return simd_level::avx2;
+		else if(__builtin_cpu_supports("sse4.1"))
+			return simd_level::sse41;
+		else
+			return simd_level::none;
+	}();
+	return level;
+#else
+	return simd_level::none;
+#endif
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_SIMD_H */
@@ -0,0 +1,409 @@
+#ifndef TIMSORT_SIMD_MERGE_H
+#define TIMSORT_SIMD_MERGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "compiler.h"
+#include "utils.h"
+#include "simd.h"
+
+namespace tim {
+namespace internal {
+
+/**
+ * Whether merges of 'T's ordered by 'Comp' can be done by a vectorized
+ * merge network.  Merge networks don't keep equal elements in order, so
+ * this is restricted to 32 and 64-bit integers with the builtin comparison
+ * operators, where equal elements can't be told apart.  (Floating point
+ * types are excluded because of -0.0 == 0.0 and NaNs.)
+ */
+template <class T, class Comp>
+inline constexpr const bool simd_mergeable_v =
+	    std::is_integral_v<T>
+	and (not std::is_same_v<T, bool>)
+	and (sizeof(T) == 4 or sizeof(T) == 8)
+	and (is_builtin_ascending_comparator_v<T, Comp> or is_builtin_descending_comparator_v<T, Comp>);
+
+/**
+ * Shortest run (after trimming) for which a merge is vectorized.
+ */
+inline constexpr const std::size_t simd_merge_min_length = 16;
+
+/*
+ * Merge cursors.  Forward cursors read (and write) upward from 'p',
+ * backward cursors read downward from 'p - 1'.  Either way, [p, end) or
+ * [end, p) is what's left.
+ */
+template <bool Backward, class T>
+inline T cursor_head(const T* p) noexcept
+{
+	if constexpr(Backward)
+		return p[-1];
+	else
+		return *p;
+}
+
+template <bool Backward, class T>
+inline std::ptrdiff_t cursor_remaining(const T* p, const T* end) noexcept
+{
+	if constexpr(Backward)
+		return p - end;
+	else
+		return end - p;
+}
+
+template <bool Backward, class T>
+inline void cursor_put(T*& dest, T value) noexcept
+{
+	if constexpr(Backward)
+		*--dest = value;
+	else
+		*dest++ = value;
+}
+
+template <bool Backward, class T>
+inline void cursor_advance(const T*& p) noexcept
+{
+	if constexpr(Backward)
+		--p;
+	else
+		++p;
+}
+
+/**
+ * @brief Finish a vectorized merge.
+ * @param carry      The elements left in the merge network's register, in
+ *                   merge order.
+ * @param [a, a_end) What's left of the buffered run.
+ * @param [b, b_end) What's left of the run still in place.
+ * @param dest       Where the next merged element goes.
+ *
+ * Everything merged so far goes before all of these, but the carried
+ * elements may still go after some of the remaining input, so this is a
+ * three-way merge until they're used up.  Whatever is left of [b, b_end)
+ * at the end is already where it belongs.
+ */
+template <bool Backward, class T, class Cmp>
+void finish_simd_merge(const T* carry, const T* carry_end,
+		       const T* a, const T* a_end,
+		       const T* b, const T* b_end,
+		       T* dest, Cmp cmp)
+{
+	while(carry < carry_end)
+	{
+		const bool a_left = cursor_remaining<Backward>(a, a_end) > 0;
+		const bool b_left = cursor_remaining<Backward>(b, b_end) > 0;
+		if(b_left and cmp(cursor_head<Backward>(b), *carry)
+		   and not (a_left and cmp(cursor_head<Backward>(a), cursor_head<Backward>(b))))
+		{
+			cursor_put<Backward>(dest, cursor_head<Backward>(b));
+			cursor_advance<Backward>(b);
+		}
+		else if(a_left and cmp(cursor_head<Backward>(a), *carry))
+		{
+			cursor_put<Backward>(dest, cursor_head<Backward>(a));
+			cursor_advance<Backward>(a);
+		}
+		else
+		{
+			cursor_put<Backward>(dest, *carry);
+			++carry;
+		}
+	}
+	while(cursor_remaining<Backward>(a, a_end) > 0 and cursor_remaining<Backward>(b, b_end) > 0)
+	{
+		if(cmp(cursor_head<Backward>(b), cursor_head<Backward>(a)))
+		{
+			cursor_put<Backward>(dest, cursor_head<Backward>(b));
+			cursor_advance<Backward>(b);
+		}
+		else
+		{
+			cursor_put<Backward>(dest, cursor_head<Backward>(a));
+			cursor_advance<Backward>(a);
+		}
+	}
+	if(const auto count = cursor_remaining<Backward>(a, a_end); count > 0)
+	{
+		if constexpr(Backward)
+			std::memcpy(dest - count, a_end, count * sizeof(T));
+		else
+			std::memcpy(dest, a, count * sizeof(T));
+	}
+}
+
+/**
+ * Bits to flip in each element so that comparing the results as signed
+ * integers orders them the way the merge should go: unsigned types get
+ * their sign bit flipped, and flipping every bit reverses the order.
+ */
+template <class T, bool Reverse>
+constexpr T simd_key_mask() noexcept
+{
+	using unsigned_type = std::make_unsigned_t<T>;
+	unsigned_type mask = std::is_signed_v<T> ? 0 : (unsigned_type(1) << (8 * sizeof(T) - 1));
+	if(Reverse)
+		mask = ~mask;
+	return static_cast<T>(mask);
+}
+
+#if defined COMPILER_X86_SIMD_ && !defined TIMSORT_NO_SIMD_MERGE
+
+/*
+ * VECTOR TRAITS
+ *
+ * Each provides, for one instruction set and element size:
+ * 	vec, width      The register type and the number of elements in it.
+ * 	broadcast(x)    A register with every element set to 'x'.
+ * 	load(p)         Unaligned load of 'width' elements at 'p'.
+ * 	store(p, v)     Unaligned store of 'v' to 'p'.
+ * 	bit_xor(a, b)   a ^ b
+ * 	reverse(v)      'v' with its elements in reverse order.
+ * 	merge(lo, hi)   Given two registers sorted in ascending (signed) 
+ * 	                order, leave the smallest 'width' elements of both
+ * 	                in 'lo' and the rest in 'hi', both sorted.  A 
+ * 	                bitonic merge network.
+ */
+
+#define TIMSORT_SIMD_TRAITS_COMMON_(target, vec_type, int_type, load_fn, store_fn, xor_fn, set1_fn)	\
+	using vec = vec_type;											\
+	static constexpr const std::ptrdiff_t width = sizeof(vec_type) / sizeof(int_type);			\
+														\
+	COMPILER_TARGET_(target) static inline vec broadcast(int_type x) noexcept				\
+	{													\
+		return set1_fn(x);										\
+	}													\
+														\
+	COMPILER_TARGET_(target) static inline vec load(const void* p) noexcept				\
+	{													\
+		return load_fn(static_cast<const vec*>(p));							\
+	}													\
+														\
+	COMPILER_TARGET_(target) static inline void store(void* p, vec v) noexcept				\
+	{													\
+		store_fn(static_cast<vec*>(p), v);								\
+	}													\
+														\
+	COMPILER_TARGET_(target) static inline vec bit_xor(vec a, vec b) noexcept				\
+	{													\
+		return xor_fn(a, b);										\
+	}
+
+struct avx2_epi32
+{
+	TIMSORT_SIMD_TRAITS_COMMON_("avx2", __m256i, std::int32_t, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_xor_si256, _mm256_set1_epi32)
+
+	COMPILER_TARGET_("avx2") static inline vec reverse(vec v) noexcept
+	{
+		return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	}
+
+	COMPILER_TARGET_("avx2") static inline vec sort_bitonic(vec v) noexcept
+	{
+		vec t = _mm256_permute2x128_si256(v, v, 1);
+		v = _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xF0);
+		t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		v = _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xCC);
+		t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xAA);
+	}
+
+	COMPILER_TARGET_("avx2") static inline void merge(vec& lo, vec& hi) noexcept
+	{
+		hi = reverse(hi);
+		const vec l = _mm256_min_epi32(lo, hi);
+		const vec h = _mm256_max_epi32(lo, hi);
+		lo = sort_bitonic(l);
+		hi = sort_bitonic(h);
+	}
+};
+
+struct avx2_epi64
+{
+	TIMSORT_SIMD_TRAITS_COMMON_("avx2", __m256i, std::int64_t, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_xor_si256, _mm256_set1_epi64x)
+
+	COMPILER_TARGET_("avx2") static inline vec reverse(vec v) noexcept
+	{
+		return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+
+	// AVX2 has no 64-bit min/max
+	COMPILER_TARGET_("avx2") static inline void min_max(vec a, vec b, vec& mn, vec& mx) noexcept
+	{
+		const vec greater = _mm256_cmpgt_epi64(a, b);
+		mn = _mm256_blendv_epi8(a, b, greater);
+		mx = _mm256_blendv_epi8(b, a, greater);
+	}
+
+	COMPILER_TARGET_("avx2") static inline vec sort_bitonic(vec v) noexcept
+	{
+		vec mn, mx;
+		min_max(v, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2)), mn, mx);
+		v = _mm256_blend_epi32(mn, mx, 0xF0);
+		min_max(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)), mn, mx);
+		return _mm256_blend_epi32(mn, mx, 0xCC);
+	}
+
+	COMPILER_TARGET_("avx2") static inline void merge(vec& lo, vec& hi) noexcept
+	{
+		vec l, h;
+		min_max(lo, reverse(hi), l, h);
+		lo = sort_bitonic(l);
+		hi = sort_bitonic(h);
+	}
+};
+
+struct sse41_epi32
+{
+	TIMSORT_SIMD_TRAITS_COMMON_("sse4.1", __m128i, std::int32_t, _mm_loadu_si128, _mm_storeu_si128, _mm_xor_si128, _mm_set1_epi32)
+
+	COMPILER_TARGET_("sse4.1") static inline vec reverse(vec v) noexcept
+	{
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+
+	COMPILER_TARGET_("sse4.1") static inline vec sort_bitonic(vec v) noexcept
+	{
+		vec t = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		v = _mm_blend_epi16(_mm_min_epi32(v, t), _mm_max_epi32(v, t), 0xF0);
+		t = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_blend_epi16(_mm_min_epi32(v, t), _mm_max_epi32(v, t), 0xCC);
+	}
+
+	COMPILER_TARGET_("sse4.1") static inline void merge(vec& lo, vec& hi) noexcept
+	{
+		hi = reverse(hi);
+		const vec l = _mm_min_epi32(lo, hi);
+		const vec h = _mm_max_epi32(lo, hi);
+		lo = sort_bitonic(l);
+		hi = sort_bitonic(h);
+	}
+};
+
+#undef TIMSORT_SIMD_TRAITS_COMMON_
+
+/*
+ * The merge kernel, stamped out once per instruction set since it has to
+ * be compiled for the same target as the traits it's instantiated with.
+ *
+ * Merges [a, a_end) (the buffered run) with [b, b_end) (the run still in
+ * place) into 'dest', in the direction given by 'Backward'.  Elements are
+ * xor'd with 'key_mask' on the way in and out so that the network always
+ * sorts in ascending signed order.  Each step feeds the next register's
+ * worth of elements from whichever run's next element goes first into the
+ * network along with the larger half of the last step, and stores the
+ * smaller half.  The store never overtakes the reads from [b, b_end).
+ *
+ * Requires both runs to hold at least 'width' elements.
+ */
+#define TIMSORT_SIMD_MERGE_KERNEL_(name, target)								\
+template <class Traits, bool Backward, class T, class Cmp>						\
+COMPILER_TARGET_(target)										\
+void name(const T* a, const T* a_end, const T* b, const T* b_end, T* dest, T key_mask, Cmp cmp)		\
+{													\
+	using vec = typename Traits::vec;								\
+	constexpr const std::ptrdiff_t width = Traits::width;						\
+	const vec mask = Traits::broadcast(key_mask);							\
+	vec run[2];											\
+	const T* cursors[2] = {a, b};									\
+	for(int i = 0; i < 2; ++i)									\
+	{												\
+		if constexpr(Backward)									\
+		{											\
+			cursors[i] -= width;								\
+			run[i] = Traits::bit_xor(Traits::reverse(Traits::load(cursors[i])), mask);	\
+		}											\
+		else											\
+		{											\
+			run[i] = Traits::bit_xor(Traits::load(cursors[i]), mask);			\
+			cursors[i] += width;								\
+		}											\
+	}												\
+	vec& lo = run[0];										\
+	vec& hi = run[1];										\
+	for(;;)												\
+	{												\
+		Traits::merge(lo, hi);									\
+		if constexpr(Backward)									\
+		{											\
+			dest -= width;									\
+			Traits::store(dest, Traits::reverse(Traits::bit_xor(lo, mask)));		\
+		}											\
+		else											\
+		{											\
+			Traits::store(dest, Traits::bit_xor(lo, mask));					\
+			dest += width;									\
+		}											\
+		if(cursor_remaining<Backward>(cursors[0], a_end) < width				\
+		   or cursor_remaining<Backward>(cursors[1], b_end) < width)				\
+			break;										\
+		const int next = cmp(cursor_head<Backward>(cursors[1]), cursor_head<Backward>(cursors[0]));\
+		if constexpr(Backward)									\
+		{											\
+			cursors[next] -= width;								\
+			lo = Traits::bit_xor(Traits::reverse(Traits::load(cursors[next])), mask);	\
+		}											\
+		else											\
+		{											\
+			lo = Traits::bit_xor(Traits::load(cursors[next]), mask);			\
+			cursors[next] += width;								\
+		}											\
+	}												\
+	T carry[width];											\
+	Traits::store(carry, Traits::bit_xor(hi, mask));						\
+	finish_simd_merge<Backward>(carry, carry + width, cursors[0], a_end, cursors[1], b_end, dest, cmp);\
+}
+
+TIMSORT_SIMD_MERGE_KERNEL_(simd_merge_avx2, "avx2")
+TIMSORT_SIMD_MERGE_KERNEL_(simd_merge_sse41, "sse4.1")
+
+#undef TIMSORT_SIMD_MERGE_KERNEL_
+
+#endif /* COMPILER_X86_SIMD_ */
+
+/**
+ * @brief Vectorized merge, if the CPU supports it.
+ * @return false if it doesn't, in which case nothing was done.
+ *
+ * Merges [a, a_end) with [b, b_end) into 'dest' (forward, or backward from
+ * the top of each range if 'Backward').  'cmp' is the comparator in the 
+ * direction of the merge, and 'Reverse' says whether that is descending
+ * order.  Same requirements as the kernels above, plus the usual 
+ * preconditions of TimSort::gallop_merge().
+ */
+template <bool Backward, bool Reverse, class T, class Cmp>
+inline bool try_simd_merge([[maybe_unused]] const T* a, [[maybe_unused]] const T* a_end,
+			   [[maybe_unused]] const T* b, [[maybe_unused]] const T* b_end,
+			   [[maybe_unused]] T* dest, [[maybe_unused]] Cmp cmp)
+{
+#if defined COMPILER_X86_SIMD_ && !defined TIMSORT_NO_SIMD_MERGE
+	constexpr T key_mask = simd_key_mask<T, Reverse>();
+	const simd_level level = detect_simd_level();
+	if constexpr(sizeof(T) == 4)
+	{
+		if(level == simd_level::avx2)
+		{
+			simd_merge_avx2<avx2_epi32, Backward>(a, a_end, b, b_end, dest, key_mask, cmp);
+			return true;
+		}
+		else if(level == simd_level::sse41)
+		{
+			simd_merge_sse41<sse41_epi32, Backward>(a, a_end, b, b_end, dest, key_mask, cmp);
+			return true;
+		}
+	}
+	else if(level == simd_level::avx2)
+	{
+		simd_merge_avx2<avx2_epi64, Backward>(a, a_end, b, b_end, dest, key_mask, cmp);
+		return true;
+	}
+#endif
+	return false;
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_SIMD_MERGE_H */
@@ -0,0 +1,194 @@
+#ifndef TIMSORT_SIMD_RUNS_H
+#define TIMSORT_SIMD_RUNS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "compiler.h"
+#include "utils.h"
+#include "simd.h"
+
+namespace tim {
+namespace internal {
+
+/**
+ * Whether the ends of runs of 'T's ordered by 'Comp' can be found with a
+ * vectorized scan.  The vector comparisons give the same answers as the
+ * builtin comparison operators (ordered comparisons are false for NaNs,
+ * just like operator<), so unlike merges, floating point types are fine.
+ */
+template <class T, class Comp>
+inline constexpr const bool simd_scannable_v =
+	    std::is_arithmetic_v<T>
+	and (not std::is_same_v<T, bool>)
+	and (sizeof(T) == 4 or sizeof(T) == 8)
+	and (is_builtin_ascending_comparator_v<T, Comp> or is_builtin_descending_comparator_v<T, Comp>);
+
+/**
+ * Whether runs of 'T's can be reversed with vector shuffles.
+ */
+template <class T>
+inline constexpr const bool simd_reversible_v =
+	    std::is_arithmetic_v<T>
+	and (sizeof(T) == 4 or sizeof(T) == 8);
+
+/**
+ * Length a run has to reach, one comparison at a time, before the rest of
+ * it is scanned with vector compares.  Keeps the short runs of random data
+ * from paying for the dispatch.
+ */
+inline constexpr const std::size_t simd_scan_min_length = 16;
+
+#if defined COMPILER_X86_SIMD_ && !defined TIMSORT_NO_SIMD_RUNS
+
+/**
+ * @brief Bit i of the result is set if 'cmp(p[i], p[i - 1])' for each of
+ *        the (256 / 8 / sizeof(T)) elements starting at 'p'.
+ *
+ * 'Greater' is the direction of the builtin comparator.  Unsigned integers
+ * are compared as signed integers with the sign bit flipped.
+ */
+template <bool Greater, class T>
+COMPILER_TARGET_("avx2") inline unsigned avx2_precedes_mask(const T* p) noexcept
+{
+	if constexpr(std::is_same_v<T, float>)
+	{
+		const __m256 cur = _mm256_loadu_ps(p);
+		const __m256 prev = _mm256_loadu_ps(p - 1);
+		if constexpr(Greater)
+			return _mm256_movemask_ps(_mm256_cmp_ps(cur, prev, _CMP_GT_OQ));
+		else
+			return _mm256_movemask_ps(_mm256_cmp_ps(cur, prev, _CMP_LT_OQ));
+	}
+	else if constexpr(std::is_floating_point_v<T>)
+	{
+		const __m256d cur = _mm256_loadu_pd(p);
+		const __m256d prev = _mm256_loadu_pd(p - 1);
+		if constexpr(Greater)
+			return _mm256_movemask_pd(_mm256_cmp_pd(cur, prev, _CMP_GT_OQ));
+		else
+			return _mm256_movemask_pd(_mm256_cmp_pd(cur, prev, _CMP_LT_OQ));
+	}
+	else
+	{
+		__m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p - 1));
+		if constexpr(std::is_unsigned_v<T>)
+		{
+			const __m256i sign = sizeof(T) == 4 ? _mm256_set1_epi32(INT32_MIN) : _mm256_set1_epi64x(INT64_MIN);
+			cur = _mm256_xor_si256(cur, sign);
+			prev = _mm256_xor_si256(prev, sign);
+		}
+		// 'cur < prev' is 'prev > cur'
+		const __m256i greater = Greater ? cur : prev;
+		const __m256i lesser = Greater ? prev : cur;
+		if constexpr(sizeof(T) == 4)
+			return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(greater, lesser)));
+		else
+			return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(greater, lesser)));
+	}
+}
+
+/**
+ * @brief Advance 'idx' past the elements of [p + idx, p + count) that
+ *        continue the run ending at p[idx - 1], two registers at a time.
+ *
+ * Stops at the end of the run, or when fewer than two registers' worth of
+ * elements are left.  The caller finishes the job one element at a time.
+ */
+template <bool Descending, bool Greater, class T>
+COMPILER_TARGET_("avx2") std::size_t avx2_scan_run(const T* p, std::size_t idx, std::size_t count) noexcept
+{
+	constexpr std::size_t width = 32 / sizeof(T);
+	constexpr unsigned all_lanes = (1u << width) - 1;
+	for(; idx + 2 * width <= count; idx += 2 * width)
+	{
+		unsigned lo = avx2_precedes_mask<Greater>(p + idx);
+		unsigned hi = avx2_precedes_mask<Greater>(p + idx + width);
+		// ascending runs end where an element precedes the one before it,
+		// descending runs end where one doesn't
+		if constexpr(Descending)
+		{
+			lo ^= all_lanes;
+			hi ^= all_lanes;
+		}
+		if(const unsigned ends = lo | (hi << width); ends != 0)
+			return idx + __builtin_ctz(ends);
+	}
+	return idx;
+}
+
+/* 'v' with its elements (of type 'T') in reverse order. */
+template <class T>
+COMPILER_TARGET_("avx2") inline __m256i avx2_reverse_lanes(__m256i v) noexcept
+{
+	if constexpr(sizeof(T) == 4)
+		return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	else
+		return _mm256_permute4x64_epi64(v, 0x1b);
+}
+
+/**
+ * @brief Reverse [first, last) by swapping whole registers from both ends,
+ *        reversing the order of the elements within each.
+ */
+template <class T>
+COMPILER_TARGET_("avx2") void avx2_reverse(T* first, T* last) noexcept
+{
+	constexpr std::ptrdiff_t width = 32 / sizeof(T);
+	while(last - first >= 2 * width)
+	{
+		last -= width;
+		const __m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+		const __m256i back = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(first), avx2_reverse_lanes<T>(back));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(last), avx2_reverse_lanes<T>(front));
+		first += width;
+	}
+	std::reverse(first, last);
+}
+
+#endif /* COMPILER_X86_SIMD_ */
+
+/**
+ * @brief Vectorized part of a run scan, if the CPU supports it.
+ * @return The offset of the end of the run (the first element that doesn't
+ *         continue it), or some offset short of that which the caller
+ *         should continue scanning from.  'idx' if nothing was done.
+ *
+ * Scans [p + idx, p + count) for the end of the ascending (or strictly
+ * descending, if 'Descending') run that ends at p[idx - 1].  'Reverse'
+ * says whether the comparator is std::greater<> rather than std::less<>.
+ */
+template <bool Descending, bool Reverse, class T>
+inline std::size_t simd_scan_run([[maybe_unused]] const T* p, std::size_t idx, [[maybe_unused]] std::size_t count)
+{
+#if defined COMPILER_X86_SIMD_ && !defined TIMSORT_NO_SIMD_RUNS
+	if(detect_simd_level() == simd_level::avx2)
+		return avx2_scan_run<Descending, Reverse>(p, idx, count);
+#endif
+	return idx;
+}
+
+/**
+ * @brief Reverse [first, last) with vector shuffles, if the CPU supports it.
+ * @return false if it doesn't, in which case nothing was done.
+ */
+template <class T>
+inline bool try_simd_reverse([[maybe_unused]] T* first, [[maybe_unused]] T* last)
+{
+#if defined COMPILER_X86_SIMD_ && !defined TIMSORT_NO_SIMD_RUNS
+	if(detect_simd_level() == simd_level::avx2)
+	{
+		avx2_reverse(first, last);
+		return true;
+	}
+#endif
+	return false;
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_SIMD_RUNS_H */
@@ -0,0 +1,201 @@
+#ifndef TIMSORT_SMALL_SORT_H
+#define TIMSORT_SMALL_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include "compiler.h"
+#include "utils.h"
+#include "minrun.h"
+
+namespace tim {
+namespace internal {
+
+/**
+ * Whether short ranges of 'T's ordered by 'Comp' are sorted with sorting
+ * networks and branchless merges instead of an insertion sort.  Sorting
+ * networks aren't stable, so this is restricted to types whose equal
+ * elements can't be told apart (not floating point types, because of
+ * -0.0 == 0.0), compared with the builtin comparison operators.
+ */
+template <class T, class Comp>
+inline constexpr const bool network_sortable_v =
+	    (std::is_integral_v<T> or std::is_enum_v<T> or std::is_pointer_v<T>)
+	and (is_builtin_ascending_comparator_v<T, Comp> or is_builtin_descending_comparator_v<T, Comp>);
+
+/**
+ * Fewest unsorted elements for which network_small_sort() beats an
+ * insertion sort.
+ */
+inline constexpr const std::size_t small_sort_network_min = 16;
+
+/**
+ * Order 'left' and 'right' without branching.
+ */
+template <class T, class Comp>
+inline void compare_exchange(T& left, T& right, Comp comp)
+{
+	const bool swap = comp(right, left);
+	const T lo = swap ? right : left;
+	const T hi = swap ? left : right;
+	left = lo;
+	right = hi;
+}
+
+/**
+ * Sort the 8 elements starting at 'p' with an optimal (19 comparator,
+ * depth 6) sorting network.
+ */
+template <class T, class Comp>
+inline void sort8_network(T* p, Comp comp)
+{
+	compare_exchange(p[0], p[2], comp); compare_exchange(p[1], p[3], comp);
+	compare_exchange(p[4], p[6], comp); compare_exchange(p[5], p[7], comp);
+	compare_exchange(p[0], p[4], comp); compare_exchange(p[1], p[5], comp);
+	compare_exchange(p[2], p[6], comp); compare_exchange(p[3], p[7], comp);
+	compare_exchange(p[0], p[1], comp); compare_exchange(p[2], p[3], comp);
+	compare_exchange(p[4], p[5], comp); compare_exchange(p[6], p[7], comp);
+	compare_exchange(p[2], p[4], comp); compare_exchange(p[3], p[5], comp);
+	compare_exchange(p[1], p[4], comp); compare_exchange(p[3], p[6], comp);
+	compare_exchange(p[1], p[2], comp); compare_exchange(p[3], p[4], comp);
+	compare_exchange(p[5], p[6], comp);
+}
+
+/**
+ * Merge [left, left_end) and [right, right_end) into 'dest', choosing each
+ * element with conditional moves instead of a branch.
+ */
+template <class T, class Comp>
+inline void branchless_merge(const T* left, const T* left_end, const T* right, const T* right_end, T* dest, Comp comp)
+{
+	while(left < left_end and right < right_end)
+	{
+		const bool take_right = comp(*right, *left);
+		*dest++ = take_right ? *right : *left;
+		right += take_right;
+		left += not take_right;
+	}
+	dest = std::copy(left, left_end, dest);
+	std::copy(right, right_end, dest);
+}
+
+/**
+ * @brief Sort [begin, end), where [begin, mid) is already sorted, using
+ *        sorting networks and branchless merges.
+ *
+ * [mid, end) is copied to a buffer on the stack, sorted 8 elements at a
+ * time with sort8_network() (the leftover few with an insertion sort),
+ * merged bottom-up, and finally merged into place with [begin, mid) from
+ * the top down.  Requires (end - begin) <= max_minrun<value_type>().
+ */
+template <class It, class Comp>
+void network_small_sort(It begin, It mid, It end, Comp comp)
+{
+	using value_type = iterator_value_type_t<It>;
+	constexpr std::size_t capacity = max_minrun<value_type>();
+	value_type buffers[2][capacity];
+	value_type* src = buffers[0];
+	value_type* dest = buffers[1];
+	const std::size_t count = end - mid;
+	std::copy(mid, end, src);
+	std::size_t pos = 0;
+	for(; pos + 8 <= count; pos += 8)
+		sort8_network(src + pos, comp);
+	finish_insertion_sort(src + pos, src + pos + (pos < count), src + count, comp);
+	for(std::size_t width = 8; width < count; width *= 2)
+	{
+		for(std::size_t lo = 0; lo < count; lo += 2 * width)
+		{
+			const std::size_t split = std::min(lo + width, count);
+			const std::size_t hi = std::min(lo + 2 * width, count);
+			branchless_merge(src + lo, src + split, src + split, src + hi, dest + lo, comp);
+		}
+		std::swap(src, dest);
+	}
+	// merge_hi()-style: fill in from the back, taking from the buffer on ties
+	const value_type* right = src;
+	const value_type* right_end = src + count;
+	while(mid > begin and right_end > right)
+	{
+		const bool take_left = comp(right_end[-1], mid[-1]);
+		*--end = take_left ? mid[-1] : right_end[-1];
+		mid -= take_left;
+		right_end -= not take_left;
+	}
+	std::copy(right, right_end, begin);
+}
+
+/**
+ * @brief Sort [begin, end), where [begin, mid) is already sorted, and
+ *        (end - begin) <= max_minrun<value_type>().
+ */
+template <class It, class Comp>
+void default_small_sort(It begin, It mid, It end, Comp comp)
+{
+	using value_type = iterator_value_type_t<It>;
+	if constexpr(network_sortable_v<value_type, Comp>)
+	{
+		if(std::size_t(end - mid) >= small_sort_network_min)
+		{
+			network_small_sort(begin, mid, end, comp);
+			return;
+		}
+	}
+	finish_insertion_sort(begin, mid, end, comp);
+}
+
+} /* namespace internal */
+
+/**
+ * @brief Customization point for sorting short ranges of 'T's.
+ *
+ * timsort() uses small_sorter<T>::sort(begin, mid, end, comp) to extend
+ * short natural runs to minrun elements (at most 64), and to sort ranges
+ * too short to bother finding runs in.  [begin, mid) is already sorted,
+ * and the result has to be sorted stably.
+ *
+ * Specialize it for your own types to plug in a faster kernel, e.g.:
+ * 	template <>
+ * 	struct tim::small_sorter<my_type>
+ * 	{
+ * 		template <class It, class Comp>
+ * 		static void sort(It begin, It mid, It end, Comp comp);
+ * 	};
+ * The second template parameter is there for SFINAE in partial
+ * specializations.  'Comp' may be a wrapper around the comparator passed
+ * to timsort() (for instance, when counting comparisons).
+ */
+template <class T, class = void>
+struct small_sorter
+{
+	/** Only in the primary template.  See internal::has_default_small_sorter_v. */
+	using default_kernel_tag = void;
+
+	template <class It, class Comp>
+	static void sort(It begin, It mid, It end, Comp comp)
+	{
+		internal::default_small_sort(begin, mid, end, comp);
+	}
+};
+
+namespace internal {
+
+/**
+ * Whether small_sorter<T> is the library's own rather than a user's
+ * specialization.  Sorts that stand other types in for 'T's (like sorting
+ * relocatable types as bytes) must not skip a user's kernel.
+ */
+template <class T, class = void>
+struct has_default_small_sorter: std::false_type {};
+
+template <class T>
+struct has_default_small_sorter<T, std::void_t<typename small_sorter<T>::default_kernel_tag>>: std::true_type {};
+
+template <class T>
+inline constexpr const bool has_default_small_sorter_v = has_default_small_sorter<T>::value;
+
+} /* namespace internal */
+
+} /* namespace tim */
+
+#endif /* TIMSORT_SMALL_SORT_H */
@@ -0,0 +1,260 @@
+#ifndef TIMSORT_SORT_STATS_H
+#define TIMSORT_SORT_STATS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include "memcpy_algos.h"
+#include "iter.h"
+#include "utils.h"
+
+
+namespace tim {
+
+/**
+ * What timsort() did while sorting a range.  Pass one to
+ * timsort(begin, end, comp, stats) to have it filled in.
+ *
+ * Counters are added to, so one object can collect the totals of many
+ * sorts.  'minrun' and 'final_min_gallop' are those of the last sort.
+ * Ranges short enough to be insertion sorted outright only count
+ * comparisons.
+ */
+struct sort_stats
+{
+	/** 
+	 * Number of times the comparator was called.  Vectorized run scans
+	 * count one comparison per element scanned, as if they'd called it.
+	 * Vectorized merges aren't counted.
+	 */
+	std::size_t comparisons = 0;
+
+	/** Number of runs found (and pushed on to the run stack). */
+	std::size_t runs = 0;
+	/** Of those, how many were strictly descending and got reversed. */
+	std::size_t descending_runs = 0;
+	/** Of those, how many were shorter than minrun and extended by insertion sort. */
+	std::size_t forced_runs = 0;
+	/** 
+	 * Of those, how many were random-looking stretches radix sorted into
+	 * runs instead (see radix_runs.h).  These aren't natural runs, so the
+	 * natural run counters below leave them out.
+	 */
+	std::size_t radix_runs = 0;
+	/**
+	 * Of those, how many were random-looking stretches that tim::sort()
+	 * sorted into runs with std::sort() (see unstable_runs.h).  Left out
+	 * of the natural run counters too.
+	 */
+	std::size_t unstable_runs = 0;
+	/** Total length of all natural runs, before extension to minrun. */
+	std::size_t natural_run_elements = 0;
+	/** Length of the longest natural run. */
+	std::size_t longest_natural_run = 0;
+	/** natural_run_lengths[k] is the number of natural runs of length [2^k, 2^(k + 1)). */
+	std::size_t natural_run_lengths[std::numeric_limits<std::size_t>::digits] = {};
+	/** minrun used by the last sort. */
+	std::size_t minrun = 0;
+
+	/** 
+	 * Number of pairs of runs merged.  A multiway merge of k runs (see
+	 * TimSort::try_multiway_collapse()) counts as k - 1 scratch buffer
+	 * merges.
+	 */
+	std::size_t merges = 0;
+	/** Merges that buffered the smaller run in the unused part of the run stack. */
+	std::size_t stack_buffer_merges = 0;
+	/** Merges that buffered the smaller run in the scratch buffer (the heap, by default). */
+	std::size_t scratch_buffer_merges = 0;
+	/** Times a merge was split with a rotation because no buffer was big enough. */
+	std::size_t rotation_merges = 0;
+	/** Merges done by a vectorized merge network instead (see simd_merge.h). */
+	std::size_t simd_merges = 0;
+	/** Final collapses done as one multiway merge of the whole run stack. */
+	std::size_t multiway_merges = 0;
+	/** Times a merge switched from linear mode to galloping mode. */
+	std::size_t gallop_entries = 0;
+	/** min_gallop at the end of the last sort. */
+	std::size_t final_min_gallop = 0;
+
+	/**
+	 * Elements moved one at a time by merges, including moves into the
+	 * merge buffer.  Insertion sorts, run reversals and vectorized merges
+	 * aren't counted.
+	 */
+	std::size_t element_moves = 0;
+	/** Bytes memcpy()'d by merges in place of element moves. */
+	std::size_t memcpy_bytes = 0;
+};
+
+
+namespace internal {
+
+/*
+ * STATS POLICIES
+ *
+ * TimSort reports what it does to a stats policy.  no_sort_stats ignores
+ * everything and compiles away entirely.  sort_stats_recorder adds it all
+ * up in a tim::sort_stats.
+ */
+
+struct no_sort_stats
+{
+	inline void found_run(std::size_t, bool, bool) const noexcept { }
+	inline void scanned(std::size_t) const noexcept { }
+	inline void radix_sorted(std::size_t) const noexcept { }
+	inline void unstable_sorted(std::size_t) const noexcept { }
+	inline void merged() const noexcept { }
+	inline void used_stack_buffer() const noexcept { }
+	inline void used_scratch_buffer() const noexcept { }
+	inline void rotated() const noexcept { }
+	inline void simd_merged() const noexcept { }
+	inline void multiway_merged() const noexcept { }
+	inline void galloped() const noexcept { }
+	inline void moved(std::size_t) const noexcept { }
+	template <class SrcIt, class DestIt>
+	inline void moved_range(std::size_t) const noexcept { }
+	template <class It>
+	inline void filled_buffer(std::size_t) const noexcept { }
+	inline void finished(std::size_t, std::size_t) const noexcept { }
+};
+
+struct sort_stats_recorder
+{
+	explicit sort_stats_recorder(sort_stats& stats_ref) noexcept:
+		stats(&stats_ref)
+	{
+
+	}
+
+	inline void found_run(std::size_t natural_length, bool descending, bool forced) const noexcept
+	{
+		++stats->runs;
+		stats->descending_runs += descending;
+		stats->forced_runs += forced;
+		stats->natural_run_elements += natural_length;
+		stats->longest_natural_run = std::max(stats->longest_natural_run, natural_length);
+		std::size_t log2_length = 0;
+		while(natural_length >>= 1)
+			++log2_length;
+		++stats->natural_run_lengths[log2_length];
+	}
+
+	inline void radix_sorted(std::size_t) const noexcept
+	{
+		++stats->runs;
+		++stats->radix_runs;
+	}
+
+	inline void unstable_sorted(std::size_t) const noexcept
+	{
+		++stats->runs;
+		++stats->unstable_runs;
+	}
+
+	/* 'count' elements were compared to their predecessors by a vectorized run scan. */
+	inline void scanned(std::size_t count) const noexcept
+	{
+		stats->comparisons += count;
+	}
+
+	inline void merged() const noexcept
+	{
+		++stats->merges;
+	}
+
+	inline void used_stack_buffer() const noexcept
+	{
+		++stats->stack_buffer_merges;
+	}
+
+	inline void used_scratch_buffer() const noexcept
+	{
+		++stats->scratch_buffer_merges;
+	}
+
+	inline void rotated() const noexcept
+	{
+		++stats->rotation_merges;
+	}
+
+	inline void simd_merged() const noexcept
+	{
+		++stats->simd_merges;
+	}
+
+	inline void multiway_merged() const noexcept
+	{
+		++stats->multiway_merges;
+	}
+
+	inline void galloped() const noexcept
+	{
+		++stats->gallop_entries;
+	}
+
+	inline void moved(std::size_t count) const noexcept
+	{
+		stats->element_moves += count;
+	}
+
+	/* Mirrors the choice made by move_or_memcpy(). */
+	template <class SrcIt, class DestIt>
+	inline void moved_range(std::size_t count) const noexcept
+	{
+		if constexpr((can_forward_memcpy_v<SrcIt> and can_forward_memcpy_v<DestIt>)
+			     or (can_reverse_memcpy_v<SrcIt> and can_reverse_memcpy_v<DestIt>))
+			stats->memcpy_bytes += count * sizeof(iterator_value_type_t<SrcIt>);
+		else
+			stats->element_moves += count;
+	}
+
+	/* Mirrors the choice made when filling a merge buffer from [begin, begin + count). */
+	template <class It>
+	inline void filled_buffer(std::size_t count) const noexcept
+	{
+		if constexpr(can_forward_memcpy_v<It> or can_reverse_memcpy_v<It>)
+			stats->memcpy_bytes += count * sizeof(iterator_value_type_t<It>);
+		else
+			stats->element_moves += count;
+	}
+
+	inline void finished(std::size_t minrun, std::size_t min_gallop) const noexcept
+	{
+		stats->minrun = minrun;
+		stats->final_min_gallop = min_gallop;
+	}
+
+	sort_stats* stats;
+};
+
+/**
+ * Comparator that counts how many times it's called.
+ */
+template <class Comp>
+struct counting_comparator
+{
+	template <class Left, class Right>
+	inline bool operator()(Left&& left, Right&& right) const
+		noexcept(noexcept(std::declval<const Comp&>()(std::forward<Left>(left), std::forward<Right>(right))))
+	{
+		++*count;
+		return comp(std::forward<Left>(left), std::forward<Right>(right));
+	}
+
+	Comp comp;
+	std::size_t* count;
+};
+
+template <class Comp>
+struct unwrap_comparator<counting_comparator<Comp>>
+{
+	using type = Comp;
+};
+
+} /* namespace internal */
+} /* namespace tim */
+
+
+#endif /* TIMSORT_SORT_STATS_H */
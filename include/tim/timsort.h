@@ -3,14 +3,31 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <iterator>
 #include <utility>
 #include <functional>
 #include <vector>
 #include <limits>
+#include <memory>
+#ifdef __has_include
+# if __has_include(<memory_resource>)
+#  include <memory_resource>
+# endif
+#endif
 #include "utils.h"
 #include "timsort_stack_buffer.h"
 #include "minrun.h"
+#include "merge_policy.h"
+#include "scratch_buffer.h"
+#include "sort_stats.h"
+#include "simd_merge.h"
+#include "simd_runs.h"
+#include "small_sort.h"
+#include "radix_runs.h"
+#include "unstable_runs.h"
+#include "loser_tree.h"
+#include "relocation.h"
 #include "compiler.h"
 
 namespace tim {
@@ -18,98 +35,408 @@ namespace tim {
 namespace internal {
 
 template <class It,
-	  class Comp>
+	  class Comp,
+	  class MergePolicy = timsort_merge_policy,
+	  class Scratch = heap_scratch<iterator_value_type_t<It>>,
+	  class Stats = no_sort_stats,
+	  bool Stable = true>
 struct TimSort
 {
 	/**
-	 * @brief Perform a timsort on the range [begin_it, end_it).
+	 * @brief Set up a timsort of the range [begin_it, end_it).  Nothing is
+	 *        sorted until sort() is called.
 	 * @param begin_it   Random access iterator to the first element in the range.
 	 * @param end_it     Past-the-end random access iterator.
 	 * @param comp_func  Comparator to use.
+	 * @param scratch_buf  Merge buffer to use when the stack buffer is too small.
+	 * @param stats_sink   Where to report what the sort did.  See sort_stats.h.
 	 */ 
 	using value_type = iterator_value_type_t<It>;
-	TimSort(It begin_it, It end_it, Comp comp_func):
+	TimSort(It begin_it, It end_it, Comp comp_func, Scratch scratch_buf = Scratch{}, Stats stats_sink = Stats{}):
 		stack_buffer{},
-		heap_buffer{},
+		scratch(std::move(scratch_buf)),
 		start(begin_it), 
 		stop(end_it),
 		position(begin_it),
+		radix_checked_until(begin_it),
+		unstable_checked_until(begin_it),
 		comp(comp_func), 
 		minrun(compute_minrun<value_type>(end_it - begin_it)),
-		min_gallop(default_min_gallop)
+		min_gallop(default_min_gallop),
+		merge_policy{},
+		stats(stats_sink)
 	{
-		// try_get_cached_heap_buffer(heap_buffer);
+
+	}
+
+	/**
+	 * @brief Sort the range.
+	 * @param presorted  Length of a prefix of the range that is already
+	 *                   sorted and can be pushed as the first run without
+	 *                   looking at it.
+	 */
+	void sort(std::size_t presorted = 0)
+	{
+		try_get_cached_heap_buffer(scratch);
+		if(presorted > 0)
+		{
+			position = start + presorted;
+			stack_buffer.push(presorted);
+		}
+		else
+		{
+			// push the first run on to the run stack unconditionally.
+			push_next_run();
+		}
 		fill_run_stack();
 		collapse_run_stack();
-		// try_cache_heap_buffer(heap_buffer);
+		try_cache_heap_buffer(scratch);
+		stats.finished(minrun, min_gallop);
 	}
 	
 	
+	/**
+	 * @brief Merge runs that the caller already knows are sorted, without
+	 *        looking for runs at all.
+	 * @param first, last  Offsets (from the start of the range) of the
+	 *                     boundaries between the runs, in increasing order.
+	 *
+	 * Every run is pushed on to the run stack as it is, however short, and
+	 * merged as the merge policy sees fit.  Boundaries at either end of the
+	 * range, and repeats of the previous boundary, delimit empty runs and
+	 * are skipped.
+	 */
+	template <class OffsetIt>
+	void sort_known_runs(OffsetIt first, OffsetIt last)
+	{
+		try_get_cached_heap_buffer(scratch);
+		const std::size_t len = stop - start;
+		std::size_t run_begin = 0;
+		for(;; ++first)
+		{
+			const std::size_t run_end = first != last ? std::min<std::size_t>(*first, len) : len;
+			if(run_end > run_begin)
+			{
+				// the first run is pushed unconditionally, like in sort()
+				if(run_begin > 0)
+					resolve_invariants(run_end);
+				stack_buffer.push(run_end);
+				stats.found_run(run_end - run_begin, false, false);
+				run_begin = run_end;
+			}
+			if(first == last)
+				break;
+		}
+		position = stop;
+		collapse_run_stack();
+		try_cache_heap_buffer(scratch);
+		stats.finished(minrun, min_gallop);
+	}
+	
+	/**
+	 * @brief Stably sort just enough of the range to put its 'k' smallest
+	 *        elements, in order, in [start, start + k).
+	 *
+	 * Until the run stack holds a run 'k' long, runs are found as usual,
+	 * but only their first 'k' elements are kept (packed together at the
+	 * start of the range by swapping them with discarded elements) and
+	 * merged: nothing after those can make it, since 'k' elements that go
+	 * no later come before it.  For the same reason, once a run on the
+	 * stack is 'k' long, nothing that doesn't go before its k'th element
+	 * can make it either.  From then on the rest of the range is filtered
+	 * against that element, one comparison each, and the few elements
+	 * that pass are gathered up, sorted and merged in batches, which makes
+	 * the threshold tighter as it goes.  Runs are cut back to 'k' whenever
+	 * they're on top of the stack.
+	 *
+	 * The rest of the range is left in an unspecified order.  Requires
+	 * 0 < k < stop - start.
+	 */
+	void sort_prefix(std::size_t k)
+	{
+		try_get_cached_heap_buffer(scratch);
+		// [0, kept) holds the runs on the stack
+		std::size_t kept = 0;
+		const std::size_t batch = std::max(k, minrun);
+		while(position < stop)
+		{
+			const It threshold = prefix_threshold(k);
+			if(threshold == stop)
+			{
+				const std::size_t run_begin = position - start;
+				const std::size_t run_end = find_next_run();
+				const std::size_t keep = std::min(run_end - run_begin, k);
+				if(run_begin - kept >= keep)
+					std::swap_ranges(start + kept, start + (kept + keep), start + run_begin);
+				else if(run_begin > kept)
+					std::rotate(start + kept, start + run_begin, start + (run_begin + keep));
+				kept = push_prefix_run(kept + keep, k);
+			}
+			else
+			{
+				// the threshold is in [start, start + kept), out of harm's way
+				std::size_t passed = 0;
+				for(; position < stop and passed < batch; ++position)
+				{
+					if(comp(*position, *threshold))
+					{
+						std::iter_swap(start + (kept + passed), position);
+						++passed;
+					}
+				}
+				if(passed > 0)
+				{
+					const It passed_begin = start + kept;
+					if(passed > max_minrun<value_type>())
+						TimSort<It, Comp, MergePolicy>(passed_begin, passed_begin + passed, comp).sort();
+					else
+						small_sorter<value_type>::sort(passed_begin, passed_begin + 1, passed_begin + passed, comp);
+					kept = push_prefix_run(kept + passed, k);
+				}
+			}
+		}
+		for(auto count = stack_buffer.run_count() - 1; count > 0; --count)
+		{
+			merge_BC();
+			truncate_top_run(k);
+		}
+		try_cache_heap_buffer(scratch);
+		stats.finished(minrun, min_gallop);
+	}
+
 	/* 
-	 * Continually push runs onto the run stack, merging adjacent runs
-	 * to resolve invariants on the size of the runs in the stack along 
-	 * the way.
+	 * Push the run ending at 'run_end' for sort_prefix(), cut back to 'k'.
+	 * Returns where the runs on the stack end.
+	 */
+	std::size_t push_prefix_run(std::size_t run_end, std::size_t k)
+	{
+		if(stack_buffer.run_count() > 0)
+			resolve_invariants(run_end);
+		stack_buffer.push(run_end);
+		return truncate_top_run(k);
+	}
+
+	/*
+	 * The smallest k'th element of the runs on the stack at least 'k'
+	 * long, or 'stop' if there aren't any.  No element that doesn't go
+	 * before it can be among the first 'k'.
+	 */
+	It prefix_threshold(std::size_t k) const
+	{
+		It threshold = stop;
+		for(std::size_t i = 0, count = stack_buffer.run_count(); i < count; ++i)
+		{
+			if(stack_buffer[i] - stack_buffer[i + 1] < k)
+				continue;
+			const It candidate = start + (stack_buffer[i + 1] + k - 1);
+			if(threshold == stop or comp(*candidate, *threshold))
+				threshold = candidate;
+		}
+		return threshold;
+	}
+
+	/* Cut the run on top of the stack back to 'k' elements.  Returns where it ends. */
+	std::size_t truncate_top_run(std::size_t k) noexcept
+	{
+		auto& run_end = stack_buffer.template get_offset<0>();
+		run_end = std::min<std::size_t>(run_end, get_offset<1>() + k);
+		return run_end;
+	}
+	
+	/*
+	 * Continually push runs onto the run stack, letting the merge policy
+	 * merge adjacent runs on the stack before each push.  The first run
+	 * must already be on the stack.
 	 */
 	void fill_run_stack()
 	{
-		// push the first two runs on to the run stack, unless there's
-		// only one run.
-		push_next_run();
-		if(not (position < stop))
-			return;
-		push_next_run();
 		while(position < stop)
 		{
-			// resolve invariants before pushing the next run
-			resolve_invariants();
-			push_next_run();
+			// find the next run, resolve invariants, and only then
+			// push it.  some merge policies need to know where the
+			// next run ends before deciding what to merge.
+			const std::size_t run_end = find_next_run();
+			resolve_invariants(run_end);
+			stack_buffer.push(run_end);
 		}
 	}
 	
 	/* 
 	 * Grand finale.  Keep merging the top 2 runs on the stack until there
-	 * is only one left.
+	 * is only one left, unless merging them all at once is cheaper.
 	 */
 	inline void collapse_run_stack()
 	{
+		if constexpr(multiway_collapse_enabled)
+		{
+			if(stack_buffer.run_count() >= multiway_collapse_min_runs and try_multiway_collapse())
+				return;
+		}
 		for(auto count = stack_buffer.run_count() - 1; count > 0; --count)
 			merge_BC();
 	}
 
+	/*
+	 * Collapse the whole run stack with one multiway merge, if that moves
+	 * fewer elements than the usual chain of pairwise merges, in which the
+	 * elements of the top runs are moved (and buffered) once per run below
+	 * them.  Returns false, having done nothing, if not.
+	 *
+	 * Everything above the bottom run is moved into the scratch buffer
+	 * and merged back from the right, like merge_hi(): a loser tree picks
+	 * the largest head among the buffered runs, and that is compared with
+	 * the last element left in the bottom run.  So elements of the bottom
+	 * (biggest) run cost one comparison and at most one move each, as
+	 * they would in the last pairwise merge, and the others move twice.
+	 * The tail of the top run that's already in place stays put.  Only
+	 * done when neighbouring runs overlap; otherwise galloping makes
+	 * pairwise merges nearly free.
+	 */
+	bool try_multiway_collapse()
+	{
+		const std::size_t count = stack_buffer.run_count();
+		const std::size_t len = stop - start;
+		// moves made by pairwise merges, ignoring galloping: each one
+		// moves the smaller run into the merge buffer and then both runs
+		// into place.  every run has to overlap the next for that to be
+		// about right.
+		std::size_t pairwise_moves = 0;
+		std::size_t merged = stack_buffer[0] - stack_buffer[1];
+		for(std::size_t i = 1; i < count; ++i)
+		{
+			if(not comp(start[stack_buffer[i]], start[stack_buffer[i] - 1]))
+				return false;
+			const std::size_t run = stack_buffer[i] - stack_buffer[i + 1];
+			pairwise_moves += run + merged + std::min(run, merged);
+			merged += run;
+		}
+		const It mid = start + stack_buffer[count - 1];
+		const It top_begin = start + stack_buffer[1];
+		// the tail of the top run that doesn't go before the last element
+		// of any other run is already in place.
+		It max_last = start + (stack_buffer[1] - 1);
+		for(std::size_t i = 2; i < count; ++i)
+		{
+			if(comp(*max_last, start[stack_buffer[i] - 1]))
+				max_last = start + (stack_buffer[i] - 1);
+		}
+		const It hi = gallop_upper_bound(std::make_reverse_iterator(stop),
+						 std::make_reverse_iterator(top_begin),
+						 *max_last,
+						 [comp=this->comp](auto&& a, auto&& b){
+						    return comp(std::forward<decltype(b)>(b), std::forward<decltype(a)>(a));
+						 }).base();
+		const std::size_t buffered = hi - mid;
+		const std::size_t multiway_moves = 2 * buffered + (mid - start);
+		if(multiway_moves * 10 >= pairwise_moves * 9 or buffered > scratch_elements_needed(len))
+			return false;
+
+		// source 'i' of the tree is the run 'i' down from the top, read
+		// from the right, so that equal elements from later runs win.
+		auto reverse_comp = [comp=this->comp](const value_type& a, const value_type& b) { return comp(b, a); };
+		// all on the stack: the scratch buffer is the only memory this may
+		// ask for, so that bounded scratch buffers never allocate.
+		constexpr const std::size_t max_sources = timsort_max_stack_size<std::size_t>();
+		const std::size_t sources = count - 1;
+		loser_tree<value_type, decltype(reverse_comp), max_sources> tree(sources, reverse_comp);
+		// [firsts[i], cursors[i]) is what's left of source 'i' in the buffer.
+		std::size_t firsts[max_sources];
+		std::size_t cursors[max_sources];
+		if(not scratch.reserve(buffered))
+			return false;
+		const auto buffer = scratch.fill(mid, hi);
+		stats.used_scratch_buffer();
+		stats.template filled_buffer<It>(buffered);
+		for(std::size_t i = 0; i < sources; ++i)
+		{
+			firsts[i] = stack_buffer[i + 1] - stack_buffer[count - 1];
+			cursors[i] = i > 0 ? stack_buffer[i] - stack_buffer[count - 1] : buffered;
+			// the top run may be in place already
+			if(cursors[i] > firsts[i])
+				tree.set_head(i, std::addressof(buffer[cursors[i] - 1]));
+		}
+		tree.build();
+
+		It dest = hi;
+		It bottom = mid;
+		for(std::size_t remaining = buffered; remaining > 0; --remaining)
+		{
+			const value_type& largest = *tree.winner_head();
+			// equal elements from the buffered runs go after the bottom run's
+			while(bottom > start and comp(largest, bottom[-1]))
+				*--dest = std::move(*--bottom);
+			const std::size_t source = tree.winner();
+			*--dest = std::move(buffer[--cursors[source]]);
+			tree.replace(cursors[source] > firsts[source] ? std::addressof(buffer[cursors[source] - 1]) : nullptr);
+		}
+		stats.moved(buffered + (mid - bottom));
+		stats.multiway_merged();
+		scratch.clear();
+		for(std::size_t i = 1; i < count; ++i)
+		{
+			stack_buffer.pop();
+			stats.merged();
+		}
+		stack_buffer.template get_offset<0>() = len;
+		return true;
+	}
+
+	/*
+	 * Find the next run and push it on to the run stack.
+	 */
+	void push_next_run() 
+	{
+		stack_buffer.push(find_next_run());
+	}
+
 	/* 
 	 * Get the next run of already-sorted elements.  If the length of the 
 	 * natural run is less than minrun, force it to size with an insertion sort.
+	 * Returns the offset of the end of the run.
 	 */
-
-	void push_next_run() 
+	std::size_t find_next_run() 
 	{
 		// check if the next run is at least two elements long
 		if(const std::size_t remain = stop - position;
 		   COMPILER_LIKELY_(remain > 1))
 		{
 			std::size_t idx = 2;
+			bool descending = false;
 			// descending?
 			if(comp(position[1], position[0]))
 			{
+				descending = true;
 				// see how long it is descending for and then reverse it
-				while(idx < remain and comp(position[idx], position[idx - 1]))
-					++idx;
-				std::reverse(position, position + idx);
+				idx = scan_run<true>(idx, remain);
+				reverse_run(position, position + idx);
 			}
 			// ascending 
 			// even if the run was initially descending, after reversing it the
 			// following elements may form an ascending continuation of the 
 			// now-reversed run.
 			// unconditionally attempt to continue the ascending run
-			while(idx < remain and not comp(position[idx], position[idx - 1])) 
-				++idx;
+			idx = scan_run<false>(idx, remain);
 			// if needed, force the run to 'minrun' elements, or until all elements 
 			// in the range are exhausted (whichever comes first) with an insertion
-			// sort.  
-			if(idx < remain and idx < minrun)
+			// sort (or whatever small_sorter<value_type> does; see small_sort.h).
+			const bool forced = idx < remain and idx < minrun;
+			// a short run might mean a stretch of random data that's better
+			// off radix sorted
+			if constexpr(radix_sortable_v<value_type, Comp> and can_forward_memcpy_v<It>)
+			{
+				if(forced and try_radix_run())
+					return position - start;
+			}
+			if constexpr(not Stable and unstable_runs_enabled)
+			{
+				if(forced and try_unstable_run())
+					return position - start;
+			}
+			stats.found_run(idx, descending, forced);
+			if(forced)
 			{
 				auto extend_to = std::min(minrun, remain);
-				finish_insertion_sort(position, position + idx, position + extend_to, comp);
+				small_sorter<value_type>::sort(position, position + idx, position + extend_to, comp);
 				idx = extend_to;
 			}
 			// advance 'position' by the length of the run we just found
@@ -118,10 +445,148 @@ struct TimSort
 		else
 		{
 			// only one element
+			stats.found_run(1, false, false);
 			position = stop;
 		}
-		// push the run on to the run stack.
-		stack_buffer.push(position - start);
+		return position - start;
+	}
+
+	/*
+	 * Like find_next_run(), but without reversing or extending anything:
+	 * advance 'position' past the next natural run (as it would be once a
+	 * strictly descending start was reversed) and return its length, and
+	 * whether it started out strictly descending.  See run_analysis.h.
+	 */
+	std::pair<std::size_t, bool> measure_next_run()
+	{
+		const std::size_t remain = stop - position;
+		std::size_t idx = std::min<std::size_t>(remain, 2);
+		bool descending = false;
+		if(remain > 1)
+		{
+			if(comp(position[1], position[0]))
+			{
+				descending = true;
+				idx = scan_run<true>(idx, remain);
+				// once reversed, the run would end with position[0]
+				if(idx < remain and not comp(position[idx], position[0]))
+					idx = scan_run<false>(idx + 1, remain);
+			}
+			else
+			{
+				idx = scan_run<false>(idx, remain);
+			}
+		}
+		position += idx;
+		return {idx, descending};
+	}
+
+	/*
+	 * If the radix_run_length elements starting at 'position' look like
+	 * random data, radix sort them into the next run.  Returns whether it
+	 * did.  Each stretch is only checked once; runs found in one that
+	 * didn't look random are handled as usual.  See radix_runs.h.
+	 */
+	bool try_radix_run()
+	{
+		if(position < radix_checked_until)
+			return false;
+		// only bother with full-sized chunks, and only when the merges
+		// would need at least as much scratch space anyway
+		if(std::size_t(stop - position) < radix_run_length 
+		   or std::size_t(stop - start) / 2 < radix_run_length)
+		{
+			radix_checked_until = stop;
+			return false;
+		}
+		radix_checked_until = position + radix_run_length;
+		value_type* const run = to_pointer(position);
+		if(count_run_turns(run, radix_run_length, comp) * radix_entropy_ratio <= radix_run_length)
+			return false;
+		if(not scratch.reserve(radix_run_length))
+			return false;
+		constexpr bool descending = is_builtin_descending_comparator_v<value_type, Comp>;
+		value_type* const buffer = scratch.fill(position, radix_checked_until);
+		if(lsd_radix_sort<descending>(buffer, run, radix_run_length) == buffer)
+			std::memcpy(run, buffer, radix_run_length * sizeof(value_type));
+		scratch.clear();
+		stats.radix_sorted(radix_run_length);
+		position = radix_checked_until;
+		return true;
+	}
+
+	/*
+	 * If the stretch starting at 'position' looks like random data (see
+	 * unstable_runs.h), sort it into the next run with std::sort().  Only
+	 * when not 'Stable'.  Returns whether it did.  Like radix runs, each
+	 * stretch is only checked once.
+	 */
+	bool try_unstable_run()
+	{
+		if(position < unstable_checked_until)
+			return false;
+		const It stretch_end = random_stretch_end(position, stop, comp);
+		if(stretch_end == position)
+		{
+			unstable_checked_until = position + std::min<std::size_t>(unstable_block_length, stop - position);
+			return false;
+		}
+		std::sort(position, stretch_end, comp);
+		stats.unstable_sorted(stretch_end - position);
+		position = unstable_checked_until = stretch_end;
+		return true;
+	}
+
+	/*
+	 * Advance 'idx' past the elements that continue the ascending (or, if
+	 * 'Descending', strictly descending) run starting at 'position'.  Once
+	 * the run reaches simd_scan_min_length, builtin comparisons of
+	 * arithmetic types are done a vector at a time.  See simd_runs.h.
+	 * When not 'Stable', descending runs go on through equal elements.
+	 */
+	template <bool Descending>
+	std::size_t scan_run(std::size_t idx, std::size_t remain)
+	{
+		constexpr bool vectorize = simd_scannable_v<value_type, Comp> and can_forward_memcpy_v<It>;
+		const auto continues_run = [&](std::size_t i) {
+			if constexpr(Descending and not Stable)
+				return not comp(position[i - 1], position[i]);
+			else
+				return comp(position[i], position[i - 1]) == Descending;
+		};
+		std::size_t scalar_end = remain;
+		if constexpr(vectorize)
+			scalar_end = std::min(remain, simd_scan_min_length);
+		while(idx < scalar_end and continues_run(idx))
+			++idx;
+		if constexpr(vectorize)
+		{
+			if(idx == scalar_end and idx < remain)
+			{
+				constexpr bool reverse = is_builtin_descending_comparator_v<value_type, Comp>;
+				const std::size_t scanned = simd_scan_run<Descending, reverse>(to_pointer(position), idx, remain);
+				stats.scanned(scanned - idx);
+				idx = scanned;
+				while(idx < remain and continues_run(idx))
+					++idx;
+			}
+		}
+		return idx;
+	}
+
+	/*
+	 * Reverse a strictly descending run, with vector shuffles if it's long
+	 * enough and made of arithmetic types.
+	 */
+	void reverse_run(It begin, It end)
+	{
+		if constexpr(simd_reversible_v<value_type> and can_forward_memcpy_v<It>)
+		{
+			if(std::size_t(end - begin) >= simd_scan_min_length 
+			   and try_simd_reverse(to_pointer(begin), to_pointer(end)))
+				return;
+		}
+		std::reverse(begin, end);
 	}
 	
 	/*
@@ -129,55 +594,28 @@ struct TimSort
 	 */
 	
 	/*
-	 * Assume the run stack has the following form:
-	 * 	[ ..., W, X, Y, Z]
-         * Where Z is the length of the run at the top of the run stack.
-	 * 
-	 * This function continually merges with Y with Z or X with Y until
-	 * the following invariants are satisfied:
-	 * 	(1) X > Y + Z
-	 * 	  (1.1) W > X + Y
-	 *      (2) Y > Z
-	 * 
-	 * If (1) or (1.1) are not satisfied, Y is merged with the smaller of 
-	 * X and Z.  Otherwise if (2) is not satisfied, Y and Z are merged.
-	 * 
-	 * This gives a reasonable upper bound on the size of the run stack.
-	 *
-	 *   NOTE: 
-	 *   invariant (1.1) implements a fix for a bug in the original
-	 *   implementation described here:
-	 *   http://envisage-project.eu/wp-content/uploads/2015/02/sorting.pdf
-	 *   
-	 *   The original description of these invariants written by Tim Peters 
-	 *   accounts for only the top three runs and refers to them as: A, B, 
-	 *   and C.  This implementation uses Tim's labelling scheme in some
-	 *   function names, but implements the corrected invariants as
-	 *   described above.
-	 * 
-	 * ALSO NOTE:
-	 *
-	 * For more details see:
-	 * https://github.com/python/cpython/blob/master/Objects/listsort.txt
+	 * Merge runs on the run stack as dictated by the merge policy until
+	 * it is happy to have the run ending at 'next_run_end' pushed.
+	 * See merge_policy.h.
 	 */
-	void resolve_invariants()
+	void resolve_invariants(std::size_t next_run_end)
 	{
-		// Check all of the invariants in a loop while there are at least
-		// two runs.  
-		auto run_count = stack_buffer.run_count();
-		do{
-			if(((run_count > 2) and stack_buffer.merge_ABC_case_1()) 
-			   or ((run_count > 3) and stack_buffer.merge_ABC_case_2()))
-				if(stack_buffer.merge_AB())
-					merge_AB();
-				else
-					merge_BC();
-			else if(stack_buffer.merge_BC())
+		merge_policy.begin_run(stack_buffer, stop - start, next_run_end);
+		for(;;)
+		{
+			switch(merge_policy.next_merge(stack_buffer))
+			{
+			case merge_action::merge_AB:
+				merge_AB();
+				break;
+			case merge_action::merge_BC:
 				merge_BC();
-			else
 				break;
-			--run_count;
-		} while(run_count > 1);
+			default:
+				merge_policy.end_run(stack_buffer);
+				return;
+			}
+		}
 	}
 
 	/* RUN STACK STUFF */
@@ -191,6 +629,7 @@ struct TimSort
 			   start + get_offset<1>(),
 			   start + get_offset<0>());
 		stack_buffer.template remove_run<1>();
+		stats.merged();
 	}
 	
 	/*
@@ -202,6 +641,7 @@ struct TimSort
 			   start + get_offset<2>(),
 			   start + get_offset<1>());
 		stack_buffer.template remove_run<2>();
+		stats.merged();
 	}
 
 	/*
@@ -260,6 +700,19 @@ struct TimSort
 		
 		if(COMPILER_LIKELY_(begin < mid or mid < end))
 		{
+			if constexpr(Scratch::is_bounded)
+			{
+				// the scratch buffer can't grow.  if neither it nor the
+				// stack can hold the smaller run, split the merge up
+				// until the pieces fit.
+				const auto smaller = std::min(mid - begin, end - mid);
+				if(not stack_buffer.can_acquire_merge_buffer(begin, begin + smaller)
+				   and not scratch.reserve(smaller))
+				{
+					rotate_merge(begin, mid, end);
+					return;
+				}
+			}
 			if((end - mid) > (mid - begin))
 				// merge from the left
 				do_merge(begin, mid, end, comp);
@@ -277,6 +730,90 @@ struct TimSort
 		}
 	}
 
+	/*
+	 * @brief Stably merge [lbegin, lend) and [rbegin, rend) into 'dest',
+	 *        which overlaps neither, and return the end of the output.
+	 *
+	 * Done like merge_runs(): the elements at either end that are already
+	 * in order relative to the other range are moved across in bulk (so
+	 * ranges that are in order are just copied), and only what's left in
+	 * between goes through gallop_merge().  Used by the merge tree of
+	 * the parallel sort (see parallel_timsort.h).
+	 */
+	template <class SrcIt, class DestIt>
+	DestIt merge_into(SrcIt lbegin, SrcIt lend, SrcIt rbegin, SrcIt rend, DestIt dest)
+	{
+		if(lbegin == lend or rbegin == rend)
+		{
+			dest = move_or_memcpy(lbegin, lend, dest);
+			return move_or_memcpy(rbegin, rend, dest);
+		}
+		const SrcIt lfirst = gallop_upper_bound(lbegin, lend, *rbegin, comp);
+		dest = move_or_memcpy(lbegin, lfirst, dest);
+		if(lfirst == lend)
+			return move_or_memcpy(rbegin, rend, dest);
+		const SrcIt rlast = gallop_upper_bound(std::make_reverse_iterator(rend),
+						       std::make_reverse_iterator(rbegin),
+						       lend[-1],
+						       [comp=this->comp](auto&& a, auto&& b){
+							   return comp(std::forward<decltype(b)>(b), std::forward<decltype(a)>(a));
+						       }).base();
+		dest = gallop_merge(lfirst, lend, rbegin, rlast, dest, comp);
+		return move_or_memcpy(rlast, rend, dest);
+	}
+
+	/*
+	 * @brief Merges the range [begin, mid) with the range [mid, end)
+	 *        without a merge buffer.
+	 * @param begin  Iterator to the first item in the left range.
+	 * @param mid    Iterator to the last/first item in the left/right range.
+	 * @param end    Iterator to the last item in the right range.
+	 *
+	 * The larger run is cut in half and the position of its middle element
+	 * in the other run is found.  Rotating the two inner pieces past each
+	 * other leaves two independent, smaller merges, which go back through
+	 * merge_runs() so that they use a buffer as soon as they fit in one.
+	 * O(N log(N)) moves in the worst case, but no allocation.
+	 *
+	 * Requires:
+	 *     begin < mid and mid < end.
+	 *     std::is_sorted(begin, mid, this->comp)
+	 *     std::is_sorted(mid, end, this->comp)
+	 */
+	void rotate_merge(It begin, It mid, It end)
+	{
+		if((mid - begin) == 1 and (end - mid) == 1)
+		{
+			if(comp(*mid, *begin))
+			{
+				stats.moved(2);
+				std::iter_swap(begin, mid);
+			}
+			return;
+		}
+		// cut the larger run, which has at least two elements, so that
+		// both cuts are strictly inside it and each piece gets smaller
+		It left_cut;
+		It right_cut;
+		if((mid - begin) > (end - mid))
+		{
+			left_cut = begin + (mid - begin) / 2;
+			right_cut = std::lower_bound(mid, end, *left_cut, comp);
+		}
+		else
+		{
+			right_cut = mid + (end - mid) / 2;
+			left_cut = std::upper_bound(begin, mid, *right_cut, comp);
+		}
+		stats.rotated();
+		stats.moved(right_cut - left_cut);
+		It new_mid = std::rotate(left_cut, mid, right_cut);
+		if(begin < left_cut and left_cut < new_mid)
+			merge_runs(begin, left_cut, new_mid);
+		if(new_mid < right_cut and right_cut < end)
+			merge_runs(new_mid, right_cut, end);
+	}
+
 	/* 
 	 * @brief Merges the range [begin, mid) with the range [mid, end). 
 	 * @param begin  Iterator to the first item in the left range.
@@ -296,50 +833,81 @@ struct TimSort
 		if(stack_buffer.can_acquire_merge_buffer(begin, mid)) 
 		{
 			// allocate the merge buffer on the stack
+			stats.used_stack_buffer();
+			stats.template filled_buffer<Iter>(mid - begin);
 			auto stack_mem = stack_buffer.move_to_merge_buffer(begin, mid);
-			gallop_merge(stack_mem, stack_mem + (mid - begin), 
-						     mid, end, 
-						     begin, cmp);
+			merge_buffered(stack_mem, stack_mem + (mid - begin), 
+				       mid, end, 
+				       begin, cmp);
 		}
 		else
 		{
-			// TODO: clean this up
-			// fall back to a std::vector<> for the merge buffer 
-			// try to use memcpy if possible
-			// 
-			// bypass speculative overallocation of std::vector.
-			// this measurably improves benchmarks for all cases.
-			heap_buffer.reserve(mid - begin);
-			if constexpr(can_forward_memcpy_v<Iter> or not can_reverse_memcpy_v<Iter>)
+			// fall back to the scratch buffer for the merge buffer.
+			// by default that's a std::vector<> on the heap, and
+			// reserve() throws std::bad_alloc before anything has
+			// been moved if allocation fails.  bounded scratch
+			// buffers were already checked in merge_runs().
+			scratch.reserve(mid - begin);
+			stats.used_scratch_buffer();
+			stats.template filled_buffer<Iter>(mid - begin);
+			auto scratch_mem = scratch.fill(begin, mid);
+			merge_buffered(scratch_mem, scratch_mem + (mid - begin),
+				       mid, end, 
+				       begin, cmp);
+			scratch.clear();
+		}
+	}
+
+	/**
+	 * @brief Merge the buffered left run [lbegin, lend) with the right run
+	 *        [rbegin, rend) into 'dest'.
+	 *
+	 * Long merges of 32 or 64-bit integers with the builtin comparators
+	 * are done by a vectorized merge network when the CPU has one and
+	 * galloping hasn't been paying off (min_gallop hasn't dropped).
+	 * Everything else goes through gallop_merge().  See simd_merge.h.
+	 */
+	template <class LeftIt, class RightIt, class Cmp>
+	void merge_buffered(LeftIt lbegin, LeftIt lend, RightIt rbegin, RightIt rend, RightIt dest, Cmp cmp)
+	{
+		constexpr bool forward = std::is_same_v<RightIt, It> 
+			and std::is_same_v<LeftIt, value_type*>;
+		constexpr bool backward = std::is_same_v<RightIt, std::reverse_iterator<It>> 
+			and std::is_same_v<LeftIt, std::reverse_iterator<value_type*>>;
+		if constexpr(simd_mergeable_v<value_type, Comp> and can_forward_memcpy_v<It> and (forward or backward))
+		{
+			if(min_gallop >= default_min_gallop
+			   and std::size_t(lend - lbegin) >= simd_merge_min_length
+			   and std::size_t(rend - rbegin) >= simd_merge_min_length)
 			{
-				// memcpy() it if we can
-				if constexpr (can_forward_memcpy_v<Iter>)
-				{
-					heap_buffer.resize(mid - begin);
-					std::memcpy(heap_buffer.data(), get_memcpy_iterator(begin), (mid - begin) * sizeof(value_type));
-				}
+				// whether the merge goes in descending order, in the direction it's done in
+				constexpr bool reverse = is_builtin_descending_comparator_v<value_type, Comp> != backward;
+				bool merged;
+				if constexpr(backward)
+					merged = try_simd_merge<true, reverse>(lbegin.base(), lend.base(),
+									       to_pointer(rbegin.base()), to_pointer(rend.base()),
+									       to_pointer(dest.base()), cmp);
 				else
+					merged = try_simd_merge<false, reverse>(lbegin, lend,
+										to_pointer(rbegin), to_pointer(rend),
+										to_pointer(dest), cmp);
+				if(merged)
 				{
-					heap_buffer.assign(std::make_move_iterator(begin), std::make_move_iterator(mid));
+					stats.simd_merged();
+					return;
 				}
-				gallop_merge(heap_buffer.begin(), heap_buffer.end(),
-							     mid, end, 
-							     begin, cmp);
-			}
-			else
-			{
-				heap_buffer.resize(mid - begin);
-				std::memcpy(heap_buffer.data(), get_memcpy_iterator(mid - 1), (mid - begin) * sizeof(value_type));
-				gallop_merge(heap_buffer.rbegin(), heap_buffer.rend(),
-							     mid, end, 
-							     begin, cmp);
 			}
-			// clear the vector so that the next call to reserve() 
-			// doesn't attempt to copy anything if it reallocates
-			// it also helps to call the destructors while the
-			// heap buffer is still hot (possibly cached)
-			heap_buffer.clear();
 		}
+		gallop_merge(lbegin, lend, rbegin, rend, dest, cmp);
+	}
+
+	/*
+	 * @brief Pointer to the element 'iter' refers to (or would refer to, for
+	 *        the end iterator).  Requires contiguous iterators.
+	 */
+	inline value_type* to_pointer(It iter) const noexcept
+	{
+		return get_memcpy_iterator(start) + (iter - start);
 	}
 
 	/**
@@ -366,9 +934,11 @@ struct TimSort
 	 *	lend - lbegin > 0 and rend - rbegin > 0
 	 *      cmp(*rbegin, *lbegin)
 	 *      cmp(rend[-1], lend[-1]) 
+	 *
+	 * Returns the end of the merged output.
 	 */ 
 	template <class LeftIt, class RightIt, class DestIt, class Cmp>
-	void gallop_merge(LeftIt lbegin, LeftIt lend, RightIt rbegin, RightIt rend, DestIt dest, Cmp cmp)
+	DestIt gallop_merge(LeftIt lbegin, LeftIt lend, RightIt rbegin, RightIt rend, DestIt dest, Cmp cmp)
 	{
 		// God bless you if you're reading this.  I'll try to explain 
 		// what I'm doing here to the best of my ability.  Much like the
@@ -431,29 +1001,37 @@ struct TimSort
 				{
 					// move from the right-hand-side
 					*dest = std::move(*rbegin);
+					stats.moved(1);
 					++dest;
 					++rbegin;
 					++rcount;
 					// merge is done.  copy the remaining elements from the left range and return
 					if(not (rbegin < rend))
 					{
-						move_or_memcpy(lbegin, lend, dest);
-						return;
+						stats.template moved_range<LeftIt, DestIt>(lend - lbegin);
+						return move_or_memcpy(lbegin, lend, dest);
 					}
 					else if(rcount >= min_gallop)
+					{
+						stats.galloped();
 						goto gallop_right; // continue this run in galloping mode
+					}
 					lcount = 0;
 				}
 				else
 				{
 					// move from the left-hand side
 					*dest = std::move(*lbegin);
+					stats.moved(1);
 					++dest;
 					++lbegin;
 					++lcount;
 					// don't need to check if we reached the end.  that will happen on the right-hand-side 
 					if(lcount >= min_gallop) 
+					{
+						stats.galloped();
 						goto gallop_left; // continue this run in galloping mode
+					}
 					rcount = 0;
 				}
 			}
@@ -475,6 +1053,7 @@ struct TimSort
 					lcount = num_galloped;
 				// do a binary search in the narrowed-down region
 				lcount = std::upper_bound(lbegin + (num_galloped / 2), lbegin + lcount, *rbegin, cmp) - lbegin;
+				stats.template moved_range<LeftIt, DestIt>(lcount);
 				dest = move_or_memcpy(lbegin, lbegin + lcount, dest);
 				lbegin += lcount;
 
@@ -490,14 +1069,15 @@ struct TimSort
 					rcount = num_galloped;
 				// do a binary search in the narrowed-down region
 				rcount = std::lower_bound(rbegin + (num_galloped / 2), rbegin + rcount, *lbegin, cmp) - rbegin;
+				stats.moved(rcount);
 				dest = std::move(rbegin, rbegin + rcount, dest);
 				rbegin += rcount;
 
 				// merge is done.  copy the remaining elements from the left range and return
 				if(not (rbegin < rend))
 				{
-					move_or_memcpy(lbegin, lend, dest);
-					return;
+					stats.template moved_range<LeftIt, DestIt>(lend - lbegin);
+					return move_or_memcpy(lbegin, lend, dest);
 				}
 			}
 			// exiting the loop means we just finished galloping 
@@ -505,6 +1085,7 @@ struct TimSort
 			// that 'not cmp(*rbegin, *lbegin)', so do one copy for free.
 			++min_gallop;
 			*dest = std::move(*lbegin);
+			stats.moved(1);
 			++dest;
 			++lbegin;
 		}
@@ -517,8 +1098,8 @@ struct TimSort
 	 * Empty stack space is used for merge buffer when possible.
 	 */
 	timsort_stack_buffer<std::size_t, value_type> stack_buffer; 
-	/** Fallback heap-allocated array used for merge buffer. */
-	std::vector<value_type> heap_buffer;
+	/** Fallback merge buffer.  A heap-allocated array unless the caller supplied one. */
+	Scratch scratch;
 	/** 'begin' iterator to the range being sorted. */
 	const It start;
 	/** 'end' iterator to the range being sorted. */
@@ -530,6 +1111,16 @@ struct TimSort
 	 * is collapsed.
 	 */
 	It position;
+	/**
+	 * [position, radix_checked_until) has already been found not to be
+	 * worth radix sorting.  Unused unless radix_sortable_v.
+	 */
+	It radix_checked_until;
+	/**
+	 * [position, unstable_checked_until) has already been found not to be
+	 * worth sorting with std::sort().  Unused if 'Stable'.
+	 */
+	It unstable_checked_until;
 	/** Comparator used to sort the range. */
 	Comp comp;
 	/** Minimum length of a run */
@@ -541,38 +1132,281 @@ struct TimSort
 	 */
 	std::size_t min_gallop = default_min_gallop;
 	
+	/** Decides which runs on the run stack get merged, and when. */
+	MergePolicy merge_policy;
+	/** Told about runs, merges and moves as they happen.  Does nothing by default. */
+	Stats stats;
+	
 	static constexpr const std::size_t default_min_gallop = gallop_win_dist;
+	/** Fewest runs left on the stack worth collapsing with one multiway merge. */
+	static constexpr const std::size_t multiway_collapse_min_runs = 4;
+	/**
+	 * Whether the final collapse may be a multiway merge.  It trades
+	 * moves for comparisons and loses to the vectorized and memcpy()'d
+	 * pairwise merges unless moves are what's expensive, so only for
+	 * trivially copyable types of at least 4 pointers (see minrun.h).
+	 */
+	static constexpr const bool multiway_collapse_enabled = multiway_collapse_allowed
+		and std::is_trivially_copyable_v<value_type>
+		and sizeof(value_type) >= 4 * sizeof(void*);
 };
 
 
 
 
-template <class It, class Comp>
-static void _timsort(It begin, It end, Comp comp)
+template <class MergePolicy = timsort_merge_policy,
+	  class It,
+	  class Comp,
+	  class Scratch = heap_scratch<iterator_value_type_t<It>>,
+	  class Stats = no_sort_stats>
+static void _timsort(It begin, It end, Comp comp, Scratch scratch = Scratch{}, Stats stats = Stats{})
 {
 	using value_type = iterator_value_type_t<It>;
 	std::size_t len = end - begin;
 	if(len > max_minrun<value_type>())
-		TimSort<It, Comp>(begin, end, comp);
+	{
+		if constexpr(sort_by_relocation_v<It, Comp, Scratch>)
+		{
+			// every move is a memcpy() of the elements' bytes.  see relocation.h.
+			using bytes_type = relocatable_bytes<value_type>;
+			bytes_type* const first = as_relocatable_bytes(begin);
+			TimSort<bytes_type*, relocating_comparator<value_type, Comp>, MergePolicy, relocating_scratch<Scratch>, Stats>(
+				first, first + len, relocating_comparator<value_type, Comp>{comp}, relocating_scratch<Scratch>{std::move(scratch)}, stats
+			).sort();
+		}
+		else
+		{
+			TimSort<It, Comp, MergePolicy, Scratch, Stats>(begin, end, comp, std::move(scratch), stats).sort();
+		}
+	}
 	else
-		finish_insertion_sort(begin, begin + (end > begin), end, comp);
+		small_sorter<value_type>::sort(begin, begin + (end > begin), end, comp);
+}
+
+/* Same as _timsort(), but not 'Stable'.  See tim::sort(). */
+template <class MergePolicy, class It, class Comp, class Stats = no_sort_stats>
+static void _sort(It begin, It end, Comp comp, Stats stats = Stats{})
+{
+	using value_type = iterator_value_type_t<It>;
+	if(std::size_t(end - begin) > max_minrun<value_type>())
+	{
+		TimSort<It, Comp, MergePolicy, heap_scratch<value_type>, Stats, false>(
+			begin, end, comp, heap_scratch<value_type>{}, stats
+		).sort();
+	}
+	else
+	{
+		small_sorter<value_type>::sort(begin, begin + (end > begin), end, comp);
+	}
 }
  
 } /* namespace internal */
 
 
-template <class It, class Comp>
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp'.
+ *
+ * The merge pattern can be chosen per call with the 'MergePolicy' template
+ * parameter, e.g.:
+ * 	tim::timsort<tim::powersort_merge_policy>(v.begin(), v.end());
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
 void timsort(It begin, It end, Comp comp)
 {
-	internal::_timsort(begin, end, comp);
+	internal::_timsort<MergePolicy>(begin, end, comp);
 }
 
 
-template <class It>
+template <class MergePolicy = timsort_merge_policy, class It>
 void timsort(It begin, It end)
 {
-	timsort(begin, end, tim::internal::DefaultComparator{}); 
+	timsort<MergePolicy>(begin, end, tim::internal::DefaultComparator{}); 
+}
+
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp', and
+ *        add what the sort did to 'stats'.
+ *
+ * Counting costs a little, so use this to understand how well the input
+ * suits timsort() rather than in hot paths.  See sort_stats.h.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void timsort(It begin, It end, Comp comp, sort_stats& stats)
+{
+	internal::_timsort<MergePolicy>(begin, end, 
+					internal::counting_comparator<Comp>{comp, &stats.comparisons},
+					internal::heap_scratch<internal::iterator_value_type_t<It>>{},
+					internal::sort_stats_recorder(stats));
+}
+
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp'.
+ *
+ * Same as timsort(begin, end, comp), except that it never throws
+ * std::bad_alloc.  Like std::stable_sort(), merges that can't get memory
+ * for a merge buffer are done without one (with rotations) instead, so a
+ * sort that runs out of memory slows down rather than failing.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void stable_sort(It begin, It end, Comp comp)
+{
+	internal::_timsort<MergePolicy>(begin, end, comp, internal::nothrow_heap_scratch<internal::iterator_value_type_t<It>>{});
+}
+
+template <class MergePolicy = timsort_merge_policy, class It>
+void stable_sort(It begin, It end)
+{
+	stable_sort<MergePolicy>(begin, end, tim::internal::DefaultComparator{}); 
+}
+
+/**
+ * @brief Sort the range [begin, end) with respect to 'comp', without
+ *        keeping equal elements in their original order.
+ *
+ * For when stability isn't needed: a timsort() that's free to do better
+ * on inputs that timsort() isn't good at.  Runs are found and merged as
+ * in timsort() (so presorted input is just as fast), but descending runs
+ * go on through equal elements, and a short run prompts a check of the
+ * blocks that follow: a stretch of blocks that look random is sorted with
+ * std::sort() and pushed as one run, rather than being forced into runs
+ * a minrun at a time and merged.  See unstable_runs.h.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void sort(It begin, It end, Comp comp)
+{
+	internal::_sort<MergePolicy>(begin, end, comp);
+}
+
+/**
+ * @brief Sort the range [begin, end) with respect to 'comp', as
+ *        sort(begin, end, comp) does, and add what the sort did to 'stats'.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void sort(It begin, It end, Comp comp, sort_stats& stats)
+{
+	internal::_sort<MergePolicy>(begin, end,
+				     internal::counting_comparator<Comp>{comp, &stats.comparisons},
+				     internal::sort_stats_recorder(stats));
+}
+
+template <class MergePolicy = timsort_merge_policy, class It>
+void sort(It begin, It end)
+{
+	sort<MergePolicy>(begin, end, tim::internal::DefaultComparator{}); 
+}
+
+/**
+ * @brief Put the 'middle - begin' smallest elements of [begin, end) in
+ *        [begin, middle), in stably sorted order, as if by
+ *        timsort(begin, end, comp).
+ *
+ * Like std::partial_sort(), but stable.  [middle, end) is left holding the
+ * rest of the elements, in an unspecified order.  Only the first
+ * 'middle - begin' elements of each run are kept and merged, and once a
+ * run that long has been found, the rest of the range is filtered against
+ * its last element, so that only elements that could still make it are
+ * sorted.  For small 'middle - begin', that's about one comparison per
+ * element.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void partial_timsort(It begin, It middle, It end, Comp comp)
+{
+	using value_type = internal::iterator_value_type_t<It>;
+	if(middle == begin)
+		return;
+	if(middle == end or std::size_t(end - begin) <= internal::max_minrun<value_type>())
+		internal::_timsort<MergePolicy>(begin, end, comp);
+	else
+		internal::TimSort<It, Comp, MergePolicy>(begin, end, comp).sort_prefix(middle - begin);
+}
+
+template <class MergePolicy = timsort_merge_policy, class It>
+void partial_timsort(It begin, It middle, It end)
+{
+	partial_timsort<MergePolicy>(begin, middle, end, tim::internal::DefaultComparator{}); 
+}
+
+/**
+ * @brief Stably merge the consecutive sorted runs making up [begin, end)
+ *        with respect to 'comp'.
+ * @param boundaries  Range of offsets from 'begin' at which one run ends
+ *                    and the next starts, in increasing order.
+ *
+ * For concatenations of already-sorted shards whose boundaries are known.
+ * Unlike timsort(begin, end, comp), nothing is scanned for runs: the given
+ * runs go straight on to the run stack and are only merged (galloping, as
+ * usual), saving a comparison per element, and short runs aren't extended.
+ * Offsets of 0 or end - begin, and repeated offsets (i.e. empty shards),
+ * are fine.  If a run isn't actually sorted, neither is the result.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Boundaries, class Comp>
+void merge_sorted_runs(It begin, It end, const Boundaries& boundaries, Comp comp)
+{
+	if(end - begin > 1)
+		internal::TimSort<It, Comp, MergePolicy>(begin, end, comp).sort_known_runs(std::begin(boundaries), std::end(boundaries));
+}
+
+template <class MergePolicy = timsort_merge_policy, class It, class Boundaries>
+void merge_sorted_runs(It begin, It end, const Boundaries& boundaries)
+{
+	merge_sorted_runs<MergePolicy>(begin, end, boundaries, tim::internal::DefaultComparator{}); 
+}
+
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp', using
+ *        the caller-supplied 'scratch' as the merge buffer.
+ *
+ * Never allocates.  If 'scratch' holds at least scratch_elements_needed(end - begin)
+ * elements, this is exactly as fast as timsort(begin, end, comp).  Otherwise
+ * merges that don't fit in it are split up with rotations until they do,
+ * which costs extra moves, but stays O(Nlog(N)).  Any size works, including
+ * zero.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp, class T>
+void timsort(It begin, It end, Comp comp, scratch_span<T> scratch)
+{
+	static_assert(std::is_same_v<T, internal::iterator_value_type_t<It>>,
+		      "scratch_span<T> must have the same element type as the range being sorted.");
+	internal::_timsort<MergePolicy>(begin, end, comp, internal::span_scratch<T>(scratch));
+}
+
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp', taking
+ *        the merge buffer from 'alloc' (rebound to the element type), e.g.:
+ * 	tim::timsort(v.begin(), v.end(), comp, std::allocator_arg, arena_allocator<int>(arena));
+ *
+ * For putting the merge buffer in an arena, in huge pages or in NUMA-local
+ * memory.  At most one buffer is allocated at a time, and it's returned to
+ * 'alloc' before the sort returns.  A new one is allocated when a merge
+ * doesn't fit, twice as big as the last (std::allocator gets exactly what's
+ * needed instead), so fewer than 2 * (end - begin) elements' worth are
+ * allocated in all, e.g. from a std::pmr::monotonic_buffer_resource, which
+ * doesn't reuse what's given back.  It's uninitialized memory: elements
+ * are only ever moved or memcpy()'d into it, never constructed through
+ * 'alloc'.  The allocator's pointers must be plain pointers.
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp, class Alloc>
+void timsort(It begin, It end, Comp comp, std::allocator_arg_t, const Alloc& alloc)
+{
+	using value_type = internal::iterator_value_type_t<It>;
+	using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+	internal::_timsort<MergePolicy>(begin, end, comp,
+					internal::allocator_scratch<value_type, allocator_type>(allocator_type(alloc)));
+}
+
+#ifdef __cpp_lib_memory_resource
+/**
+ * @brief Stably sort the range [begin, end) with respect to 'comp', taking
+ *        the merge buffer from 'resource', e.g. a std::pmr::monotonic_buffer_resource.
+ *        See timsort(begin, end, comp, std::allocator_arg, alloc).
+ */
+template <class MergePolicy = timsort_merge_policy, class It, class Comp>
+void timsort(It begin, It end, Comp comp, std::pmr::memory_resource* resource)
+{
+	using value_type = internal::iterator_value_type_t<It>;
+	timsort<MergePolicy>(begin, end, comp, std::allocator_arg, std::pmr::polymorphic_allocator<value_type>(resource));
 }
+#endif
 
 
 
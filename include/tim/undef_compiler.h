@@ -18,5 +18,13 @@
 # undef COMPILER_UNREACHABLE_
 #endif
 
+#ifdef 	COMPILER_X86_SIMD_ 
+# undef COMPILER_X86_SIMD_
+#endif
+
+#ifdef 	COMPILER_TARGET_ 
+# undef COMPILER_TARGET_
+#endif
+
 
 #endif /* TIMSORT_UNDEF_COMPILER_H */
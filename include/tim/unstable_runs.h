@@ -0,0 +1,48 @@
+#ifndef TIMSORT_UNSTABLE_RUNS_H
+#define TIMSORT_UNSTABLE_RUNS_H
+
+#include <cstddef>
+#include "radix_runs.h"
+
+namespace tim {
+namespace internal {
+
+#ifdef TIMSORT_NO_UNSTABLE_RUNS
+inline constexpr const bool unstable_runs_enabled = false;
+#else
+inline constexpr const bool unstable_runs_enabled = true;
+#endif
+
+/**
+ * Granularity with which tim::sort() looks for random-looking stretches to
+ * sort with std::sort() instead of finding runs in them.  Long enough that
+ * the check is a fair sample, short enough that presorted stretches after
+ * a random one aren't swallowed by it.
+ */
+inline constexpr const std::size_t unstable_block_length = std::size_t(1) << 12;
+
+/**
+ * @brief End of the stretch of blocks of 'unstable_block_length' elements
+ *        starting at 'begin' that each look random: whose neighbouring
+ *        elements' order turns more often than once every
+ *        'radix_entropy_ratio' elements, as with radix runs.
+ *
+ * Returns 'begin' if the first block doesn't look random.  A last stretch
+ * shorter than a block goes along with the blocks before it.
+ */
+template <class It, class Comp>
+It random_stretch_end(It begin, It end, Comp comp)
+{
+	It stretch_end = begin;
+	while(std::size_t(end - stretch_end) >= unstable_block_length
+	      and count_run_turns(stretch_end, unstable_block_length, comp) * radix_entropy_ratio > unstable_block_length)
+		stretch_end += unstable_block_length;
+	if(stretch_end != begin and std::size_t(end - stretch_end) < unstable_block_length)
+		stretch_end = end;
+	return stretch_end;
+}
+
+} /* namespace internal */
+} /* namespace tim */
+
+#endif /* TIMSORT_UNSTABLE_RUNS_H */
@@ -33,6 +33,35 @@ struct DefaultComparator
 	}
 };
 
+/**
+ * The comparator that 'Comp' wraps, if it's a wrapper that only adds
+ * bookkeeping.  Compile-time special cases look at this instead of at 
+ * 'Comp' so that wrapping a comparator doesn't turn them off.
+ */
+template <class Comp>
+struct unwrap_comparator
+{
+	using type = Comp;
+};
+
+template <class Comp>
+using unwrap_comparator_t = typename unwrap_comparator<Comp>::type;
+
+/**
+ * Whether 'Comp' is one of the standard function objects that order 'T's
+ * with the builtin operator< (or operator>, for the descending version).
+ */
+template <class T, class Comp>
+inline constexpr const bool is_builtin_ascending_comparator_v = 
+	   std::is_same_v<unwrap_comparator_t<Comp>, std::less<>> 
+	or std::is_same_v<unwrap_comparator_t<Comp>, std::less<T>>
+	or std::is_same_v<unwrap_comparator_t<Comp>, DefaultComparator>;
+
+template <class T, class Comp>
+inline constexpr const bool is_builtin_descending_comparator_v = 
+	   std::is_same_v<unwrap_comparator_t<Comp>, std::greater<>> 
+	or std::is_same_v<unwrap_comparator_t<Comp>, std::greater<T>>;
+
 /**
  * @brief 	 Semantically equivalent to std::upper_bound(), except requires 
  *        	 random access iterators.
@@ -135,11 +164,8 @@ void finish_insertion_sort(It begin, It mid, It end, Comp comp)
 {
 	using value_type = iterator_value_type_t<It>;
 	if constexpr(std::is_scalar_v<value_type>
-		     and (   std::is_same_v<Comp, std::less<>> 
-		          or std::is_same_v<Comp, std::less<value_type>>
-		          or std::is_same_v<Comp, std::greater<>>
-		          or std::is_same_v<Comp, std::greater<value_type>>
-		          or std::is_same_v<Comp, DefaultComparator>)
+		     and (   is_builtin_ascending_comparator_v<value_type, Comp>
+		          or is_builtin_descending_comparator_v<value_type, Comp>)
 	)
 	{
 		// if types are cheap to compare and cheap to copy, do a linear search
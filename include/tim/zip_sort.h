@@ -0,0 +1,118 @@
+#ifndef TIMSORT_ZIP_SORT_H
+#define TIMSORT_ZIP_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "timsort.h"
+#include "projection.h"
+
+
+namespace tim {
+namespace internal {
+
+struct identity_projection
+{
+	template <class T>
+	constexpr T&& operator()(T&& value) const noexcept
+	{
+		return std::forward<T>(value);
+	}
+};
+
+/**
+ * @brief Put the column starting at 'column' in the order given by 'order':
+ *        column[i] becomes what was at column[order[i].index].
+ *
+ * Gathers the column into a scratch column of its own type, then moves it
+ * back in one go (a memcpy() for contiguous, trivially copyable columns).
+ * Unlike following cycles in place, every read is independent and every
+ * write is sequential.
+ */
+template <class It, class Key, class Index>
+void gather_column(It column, const std::vector<keyed_index<Key, Index>>& order)
+{
+	std::vector<iterator_value_type_t<It>> scratch;
+	scratch.reserve(order.size());
+	for(const auto& entry: order)
+		scratch.push_back(std::move(column[entry.index]));
+	move_or_memcpy(scratch.begin(), scratch.end(), column);
+}
+
+/*
+ * Sort (key, index) pairs, then reorder each column by the indices.  Keys
+ * that are small and trivially copyable are cached by value and written
+ * straight back; others are cached by pointer and moved into place with
+ * apply_permutation() once the payloads are done with the indices.
+ */
+template <class Index, class MergePolicy, class KeyIt, class Comp, class ... PayloadIts>
+void timsort_zip_columns(KeyIt keys_begin, KeyIt keys_end, Comp comp, PayloadIts ... payloads)
+{
+	using traits = key_cache_traits<KeyIt, identity_projection>;
+	using key_type = typename traits::key_type;
+	identity_projection proj;
+	const std::size_t count = keys_end - keys_begin;
+	std::vector<keyed_index<key_type, Index>> order;
+	order.reserve(count);
+	for(std::size_t i = 0; i < count; ++i)
+		order.push_back(keyed_index<key_type, Index>{traits::make_key(proj, keys_begin[i]), static_cast<Index>(i)});
+	_timsort<MergePolicy>(order.begin(), order.end(),
+		[comp](const auto& left, const auto& right) {
+			return comp(traits::get_key(left.key), traits::get_key(right.key));
+		}
+	);
+	(gather_column(payloads, order), ...);
+	if constexpr(traits::by_pointer)
+	{
+		apply_permutation(keys_begin, keys_end, indices_of(order));
+	}
+	else
+	{
+		for(std::size_t i = 0; i < count; ++i)
+			keys_begin[i] = order[i].key;
+	}
+}
+
+} /* namespace internal */
+
+
+/**
+ * @brief Stably sort the keys in [keys_begin, keys_end) with respect to
+ *        'comp', and reorder each payload column to match.
+ *
+ * For struct-of-arrays data: 'payload_begins' are random access iterators
+ * to the starts of columns at least as long as the keys, e.g.
+ * 	tim::timsort_zip(ids.begin(), ids.end(), std::less<>{}, prices.begin(), names.data());
+ *
+ * Rather than going through a zip iterator (whose proxy references defeat
+ * the memcpy() paths and the stack merge buffer), this sorts (key, index)
+ * pairs, with 32-bit indices when the range allows, and then puts each
+ * column in order through a scratch column of its own type, which is
+ * copied back with memcpy() when it can be.  Each payload element is
+ * moved twice in all, however many merges it would have gone through.
+ * Allocates N (key, index) pairs, plus one column at a time.
+ */
+template <class MergePolicy = timsort_merge_policy, class KeyIt, class Comp, class ... PayloadIts>
+void timsort_zip(KeyIt keys_begin, KeyIt keys_end, Comp comp, PayloadIts ... payload_begins)
+{
+	if constexpr(sizeof...(PayloadIts) == 0)
+	{
+		timsort<MergePolicy>(keys_begin, keys_end, comp);
+	}
+	else
+	{
+		const std::size_t count = keys_end - keys_begin;
+		if(count < 2)
+			return;
+		if(count - 1 <= std::numeric_limits<std::uint32_t>::max())
+			internal::timsort_zip_columns<std::uint32_t, MergePolicy>(keys_begin, keys_end, comp, payload_begins...);
+		else
+			internal::timsort_zip_columns<std::size_t, MergePolicy>(keys_begin, keys_end, comp, payload_begins...);
+	}
+}
+
+} /* namespace tim */
+
+#endif /* TIMSORT_ZIP_SORT_H */
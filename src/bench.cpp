@@ -90,6 +90,25 @@ void sorted_rand_ints(It begin, It end)
 	std::sort(begin, end);
 }
 
+/*
+ * Random ints arranged as a concatenation of sorted runs whose lengths are
+ * log-uniformly distributed between 1 and a quarter of the range.  This is
+ * the kind of input where the choice of merge pattern matters most.
+ */
+template <class It>
+void irregular_runs(It begin, It end)
+{
+	rand_large_ints(begin, end);
+	const double max_log = std::log(std::max(double(end - begin) / 4, 1.0));
+	std::uniform_real_distribution<double> log_len(0.0, max_log);
+	for(auto pos = begin; pos < end;)
+	{
+		auto len = std::min(std::ptrdiff_t(std::exp(log_len(mt))) + 1, end - pos);
+		std::sort(pos, pos + len);
+		pos += len;
+	}
+}
+
 
 
 static void BM_sort_random_uniform_ints(benchmark::State& state)
@@ -140,6 +159,44 @@ static void BM_sort_random_strings(benchmark::State& state)
 	}
 }
 
+static void BM_sort_irregular_runs(benchmark::State& state)
+{
+	std::vector<integral_t> vec;
+	for(auto _: state)
+	{
+		state.PauseTiming();
+		vec.resize(state.range(0));
+		irregular_runs(vec.begin(), vec.end());
+		benchmark::DoNotOptimize(vec.data());
+		state.ResumeTiming();
+		SORT_ALGO(vec.begin(), vec.end());
+	}
+}
+
+/* 
+ * Same input as BM_sort_irregular_runs, but reports the average number of 
+ * comparisons per sort.
+ */
+static void BM_count_comparisons_irregular_runs(benchmark::State& state)
+{
+	std::vector<integral_t> vec;
+	std::size_t comparisons = 0;
+	auto compare = [&](integral_t left, integral_t right) {
+		++comparisons;
+		return left < right;
+	};
+	for(auto _: state)
+	{
+		state.PauseTiming();
+		vec.resize(state.range(0));
+		irregular_runs(vec.begin(), vec.end());
+		benchmark::DoNotOptimize(vec.data());
+		state.ResumeTiming();
+		SORT_ALGO(vec.begin(), vec.end(), compare);
+	}
+	state.counters["comparisons"] = benchmark::Counter(double(comparisons), benchmark::Counter::kAvgIterations);
+}
+
 static void BM_sort_mnist_train_labels(benchmark::State& state)
 {
 	std::vector<int> vec;
@@ -196,6 +253,8 @@ BENCHMARK(BM_sort_small_random_uniform_ints)->RangeMultiplier(8)->Range(8, 26214
 BENCHMARK_TEMPLATE(BM_sort_random_strings,  0,  8 /* ALL SSO */)->RangeMultiplier(8)->Range(8, 262144);
 BENCHMARK_TEMPLATE(BM_sort_random_strings,  0, 64 /* SOME SSO */)->RangeMultiplier(8)->Range(8, 262144);
 BENCHMARK_TEMPLATE(BM_sort_random_strings, 32, 64 /* NO SSO */ )->RangeMultiplier(8)->Range(8, 262144);
+BENCHMARK(BM_sort_irregular_runs)->RangeMultiplier(8)->Range(4096, 2097152);
+BENCHMARK(BM_count_comparisons_irregular_runs)->RangeMultiplier(8)->Range(4096, 2097152);
 BENCHMARK(BM_sort_mnist_train_labels);
 BENCHMARK_TEMPLATE(BM_sort_census_naics_data, STATE);
 BENCHMARK_TEMPLATE(BM_sort_census_naics_data, NAICS);
@@ -211,6 +270,6 @@ BENCHMARK_TEMPLATE(BM_sort_census_naics_data, STATEDSCR);
 BENCHMARK_TEMPLATE(BM_sort_census_naics_data, NAICSDSCR);
 BENCHMARK_TEMPLATE(BM_sort_census_naics_data, entrsizedscr);
 
-BENCHMARK_MAIN()
+BENCHMARK_MAIN();
 
 
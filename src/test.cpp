@@ -2,16 +2,90 @@
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
 #include "timsort.h"
+#include "parallel_timsort.h"
+#include "projection.h"
+#include "argsort.h"
+#include "zip_sort.h"
+#include "run_vector.h"
+#include "incremental_sort.h"
+#include "external_sort.h"
+#include "mapped_sort.h"
+#include "run_analysis.h"
 #include <iostream>
 #include <random>
 #include <vector>
 #include <cassert>
 #include "datasets/read_data_sets.h"
 #include <list>
+#include <numeric>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <atomic>
 
 using namespace tim;
 static std::mt19937_64 mt{std::random_device{}()};
 
+// allocations larger than this many bytes fail.  used to simulate running out of memory.
+static std::size_t max_allocation_size = std::numeric_limits<std::size_t>::max();
+
+/*
+ * The global allocation functions are replaced (rather than handing the
+ * sorts a failing allocator) so that the tests also catch memory that a
+ * sort asks for behind its merge buffer's back.  They're built on malloc()
+ * and free(), and once they're inlined g++ sees free() called on pointers
+ * from operator new, which -Wmismatched-new-delete flags.  They match
+ * here, so the warning is switched off for these definitions only.
+ */
+#if defined(__GNUC__) and not defined(__clang__) and __GNUC__ >= 11
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+	if(size > max_allocation_size)
+		throw std::bad_alloc();
+	if(void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+#if defined(__GNUC__) and not defined(__clang__) and __GNUC__ >= 11
+# pragma GCC diagnostic pop
+#endif
+
 
 static const auto & census_data()
 {
@@ -20,8 +94,8 @@ static const auto & census_data()
 }
 
 
-template <class It, class Cmp, class EqualTo>
-void test_stable_sort(It data_begin, It data_end, Cmp cmp, EqualTo equal_to = std::equal_to<>{})
+template <class Sorter, class It, class Cmp, class EqualTo>
+void test_stable_sort_with(Sorter sorter, It data_begin, It data_end, Cmp cmp, EqualTo equal_to = std::equal_to<>{})
 {
 	using value_t = typename std::iterator_traits<It>::value_type;
 	std::vector<value_t> data_copy(data_begin, data_end);
@@ -32,7 +106,7 @@ void test_stable_sort(It data_begin, It data_end, Cmp cmp, EqualTo equal_to = st
 	};
 	
 	// under test
-	timsort(data_begin, data_end, cmp);
+	sorter(data_begin, data_end, cmp);
 
 	// test that the sort did its job
 	bool sorted = std::is_sorted(data_begin, data_end, cmp);
@@ -57,6 +131,44 @@ void test_stable_sort(It data_begin, It data_end, Cmp cmp, EqualTo equal_to = st
 	}
 }
 
+template <class It, class Cmp, class EqualTo>
+void test_stable_sort(It data_begin, It data_end, Cmp cmp, EqualTo equal_to = std::equal_to<>{})
+{
+	test_stable_sort_with([](auto begin, auto end, auto comp) { timsort(begin, end, comp); },
+			      data_begin, data_end, cmp, equal_to);
+}
+
+/* Compares (key, original index) pairs by key only, so that any instability shows up. */
+static constexpr auto by_first = [](const auto& left, const auto& right) { return left.first < right.first; };
+
+/* 'size' (key, original index) pairs with random keys in [0, max_key]. */
+static std::vector<std::pair<int, std::size_t>> make_keyed_pairs(std::size_t size, int max_key)
+{
+	std::uniform_int_distribution<int> dist(0, max_key);
+	std::vector<std::pair<int, std::size_t>> data(size);
+	for(std::size_t i = 0; i < size; ++i)
+		data[i] = {dist(mt), i};
+	return data;
+}
+
+/* A (key, original index) pair too big for even one of it to fit in the stack merge buffer. */
+struct big_keyed_pair
+{
+	int first;
+	std::size_t second;
+	char padding[2048];
+	bool operator==(const big_keyed_pair& other) const { return first == other.first and second == other.second; }
+};
+
+static std::vector<big_keyed_pair> make_big_keyed_pairs(std::size_t size, int max_key)
+{
+	std::vector<big_keyed_pair> data(size);
+	const auto pairs = make_keyed_pairs(size, max_key);
+	for(std::size_t i = 0; i < size; ++i)
+		data[i] = {pairs[i].first, pairs[i].second, {}};
+	return data;
+}
+
 template <class It>
 void random_ints(It begin, It end, int minm, int maxm)
 {
@@ -209,6 +321,1442 @@ BOOST_AUTO_TEST_CASE(census_data_12)
 	test_stable_sort(data.begin(), data.end(), census_comparator<12>, std::equal_to<>{});
 }
 
+BOOST_AUTO_TEST_CASE(powersort_stable)
+{
+	auto powersort = [](auto begin, auto end, auto comp) {
+		timsort<powersort_merge_policy>(begin, end, comp);
+	};
+	for(std::size_t size: {0, 1, 2, 65, 1000, 100000})
+	{
+		// random keys with lots of duplicates
+		auto data = make_keyed_pairs(size, 50);
+		test_stable_sort_with(powersort, data.begin(), data.end(), by_first, std::equal_to<>{});
+		// sorted runs of wildly varying lengths
+		std::uniform_int_distribution<std::size_t> runlen(1, 2000);
+		for(auto pos = data.begin(); pos < data.end();)
+		{
+			auto run_end = pos + std::min(runlen(mt), std::size_t(data.end() - pos));
+			std::sort(pos, run_end, by_first);
+			pos = run_end;
+		}
+		test_stable_sort_with(powersort, data.begin(), data.end(), by_first, std::equal_to<>{});
+	}
+}
+
+BOOST_AUTO_TEST_CASE(merge_known_runs)
+{
+	std::uniform_int_distribution<int> dist(0, 100);
+	std::uniform_int_distribution<std::size_t> shard_len(0, 3000);
+	for(std::size_t shards: {0, 1, 2, 7, 100})
+	{
+		// sorted shards of random lengths, some empty
+		std::vector<std::pair<int, std::size_t>> data;
+		std::vector<std::size_t> boundaries;
+		for(std::size_t shard = 0; shard < shards; ++shard)
+		{
+			const std::size_t first = data.size();
+			for(std::size_t len = (shard % 5 == 3) ? 0 : shard_len(mt); len > 0; --len)
+				data.push_back({dist(mt), data.size()});
+			std::stable_sort(data.begin() + first, data.end(), by_first);
+			boundaries.push_back(data.size());
+		}
+		auto expected = data;
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+		auto merged = data;
+		merge_sorted_runs(merged.begin(), merged.end(), boundaries, by_first);
+		BOOST_TEST((merged == expected));
+		merged = data;
+		merge_sorted_runs<powersort_merge_policy>(merged.begin(), merged.end(), boundaries, by_first);
+		BOOST_TEST((merged == expected));
+	}
+
+	// no pass to find the runs
+	std::vector<int> ints(100000);
+	std::iota(ints.begin(), ints.end(), 0);
+	std::size_t comparisons = 0;
+	auto counting_less = [&](int left, int right) { ++comparisons; return left < right; };
+	const std::size_t halves[] = {ints.size() / 2};
+	merge_sorted_runs(ints.begin(), ints.end(), halves, counting_less);
+	BOOST_TEST(comparisons < 100u);
+	BOOST_TEST(std::is_sorted(ints.begin(), ints.end()));
+}
+
+BOOST_AUTO_TEST_CASE(partial_timsort_prefix)
+{
+	for(std::size_t size: {0, 1, 50, 1000, 100000})
+	{
+		auto data = make_keyed_pairs(size, 1000);
+		for(int shape = 0; shape < 3; ++shape)
+		{
+			if(shape == 1)
+				std::stable_sort(data.begin(), data.end(), by_first);
+			else if(shape == 2)
+				std::reverse(data.begin(), data.end());
+			auto expected = data;
+			std::stable_sort(expected.begin(), expected.end(), by_first);
+			for(std::size_t k: {std::size_t(0), std::min<std::size_t>(size, 1), size / 100, size / 2, size})
+			{
+				auto sorted = data;
+				partial_timsort(sorted.begin(), sorted.begin() + k, sorted.end(), by_first);
+				BOOST_TEST(std::equal(sorted.begin(), sorted.begin() + k, expected.begin()));
+				// the rest is still there
+				std::sort(sorted.begin() + k, sorted.end());
+				auto rest = std::vector<std::pair<int, std::size_t>>(expected.begin() + k, expected.end());
+				std::sort(rest.begin(), rest.end());
+				BOOST_TEST(std::equal(sorted.begin() + k, sorted.end(), rest.begin(), rest.end()));
+			}
+		}
+	}
+
+	// sorted input with a few strays: the top 100 come from one pass
+	std::uniform_int_distribution<int> dist(0, 1000);
+	std::vector<int> ints(100000);
+	std::iota(ints.begin(), ints.end(), 0);
+	for(int i = 0; i < 10; ++i)
+		std::swap(ints[dist(mt) * 90], ints[dist(mt) * 90 + 50]);
+	auto expected = ints;
+	std::sort(expected.begin(), expected.end());
+	std::size_t comparisons = 0;
+	partial_timsort<powersort_merge_policy>(ints.begin(), ints.begin() + 100, ints.end(),
+		[&](int left, int right) { ++comparisons; return left < right; });
+	BOOST_TEST(std::equal(ints.begin(), ints.begin() + 100, expected.begin()));
+	BOOST_TEST(comparisons < 2 * ints.size());
+}
+
+BOOST_AUTO_TEST_CASE(unstable_sort_shapes)
+{
+	// random, presorted, reversed with duplicates, random stretches between 
+	// sorted ones, and lots of duplicates, for a type with radix runs and 
+	// types without
+	auto check = [](auto data) {
+		auto expected = data;
+		std::sort(expected.begin(), expected.end());
+		auto sorted = data;
+		tim::sort(sorted.begin(), sorted.end());
+		BOOST_TEST((sorted == expected));
+		std::sort(expected.begin(), expected.end(), std::greater<>{});
+		sorted = data;
+		tim::sort(sorted.begin(), sorted.end(), std::greater<>{});
+		BOOST_TEST((sorted == expected));
+	};
+	auto shapes = [&](auto make) {
+		for(std::size_t size: {0, 1, 50, 5000, 100000})
+		{
+			std::vector<decltype(make())> data(size);
+			std::generate(data.begin(), data.end(), make);
+			check(data);
+			std::sort(data.begin(), data.end());
+			check(data);
+			std::reverse(data.begin(), data.end());
+			check(data);
+			for(std::size_t i = 0; size >= 4 and i + 3 * size / 8 < size; i += size / 4)
+				std::shuffle(data.begin() + i, data.begin() + i + size / 8, mt);
+			check(data);
+			for(auto& value: data)
+				value = data[mt() % std::min<std::size_t>(size, 8)];
+			check(data);
+		}
+	};
+	shapes([]() { return int(mt() % 1000); });
+	shapes([]() { return std::to_string(mt() % 1000); });
+	shapes([]() { return std::pair<int, int>(mt() % 100, mt() % 100); });
+
+	// random stretches sorted with std::sort() are runs, but not natural ones
+	std::vector<std::string> strs(100000);
+	std::generate(strs.begin(), strs.end(), []() { return std::to_string(mt() % 1000); });
+	sort_stats stats;
+	tim::sort(strs.begin(), strs.end(), std::less<>{}, stats);
+	BOOST_TEST(std::is_sorted(strs.begin(), strs.end()));
+	BOOST_TEST(stats.unstable_runs > 0u);
+	BOOST_TEST(stats.radix_runs == 0u);
+	BOOST_TEST(stats.longest_natural_run < stats.minrun);
+	BOOST_TEST(stats.natural_run_elements < strs.size() / 2);
+	BOOST_TEST(std::accumulate(std::begin(stats.natural_run_lengths), std::end(stats.natural_run_lengths), std::size_t(0)) == stats.runs - stats.unstable_runs);
+}
+
+BOOST_AUTO_TEST_CASE(analyze_runs_presortedness)
+{
+	// ascending blocks of 2, 4, ..., 4096 elements, each below the one 
+	// before, then a strictly descending block
+	std::vector<int> data;
+	int top = 1 << 20;
+	for(int length = 2; length <= 4096; length *= 2)
+	{
+		top -= length;
+		for(int i = 0; i < length; ++i)
+			data.push_back(top + i);
+	}
+	for(int i = 0; i < 100; ++i)
+		data.push_back(-i);
+	const auto original = data;
+	const auto analysis = analyze_runs(data.begin(), data.end());
+	BOOST_TEST(data == original);
+	BOOST_TEST(analysis.elements == data.size());
+	BOOST_TEST(analysis.runs == 13u);
+	BOOST_TEST(analysis.descending_runs == 1u);
+	BOOST_TEST(analysis.longest_run == 4096u);
+	BOOST_TEST(analysis.run_lengths[1] == 1u);
+	BOOST_TEST(analysis.run_lengths[6] == 2u);
+	BOOST_TEST(analysis.run_lengths[12] == 1u);
+	BOOST_TEST(analysis.descending_fraction == 100.0 / data.size(), boost::test_tools::tolerance(1e-9));
+	double entropy = 0.0;
+	for(double length: {2.0, 4.0, 8.0, 16.0, 32.0, 64.0, 128.0, 256.0, 512.0, 1024.0, 2048.0, 4096.0, 100.0})
+		entropy += length / data.size() * std::log2(data.size() / length);
+	BOOST_TEST(analysis.entropy == entropy, boost::test_tools::tolerance(1e-9));
+	BOOST_TEST(not analysis.sorted());
+	BOOST_TEST(not analysis.sampled);
+
+	std::vector<std::string> strs(100000);
+	std::generate(strs.begin(), strs.end(), [&]() { return std::to_string(mt()); });
+	const auto random = analyze_runs(strs.begin(), strs.end());
+	std::sort(strs.begin(), strs.end());
+	const auto sorted = analyze_runs(strs.begin(), strs.end());
+	BOOST_TEST(random.runs > strs.size() / 4);
+	BOOST_TEST(random.entropy > 10.0);
+	BOOST_TEST(sorted.sorted());
+	BOOST_TEST(sorted.entropy == 0.0);
+	BOOST_TEST(sorted.predicted_comparisons == strs.size() - 1.0);
+	BOOST_TEST(sorted.predicted_comparisons < random.predicted_comparisons / 10);
+	std::reverse(strs.begin(), strs.end());
+	const auto reversed = analyze_runs(strs.begin(), strs.end(), std::less<>{});
+	BOOST_TEST(reversed.runs == 1u);
+	BOOST_TEST(reversed.descending_runs == 1u);
+	BOOST_TEST(not reversed.sorted());
+
+	// sampling sees about the same, looking at a fraction of the range
+	std::vector<std::uint64_t> ints(1 << 20);
+	std::generate(ints.begin(), ints.end(), [&]() { return mt(); });
+	std::size_t comparisons = 0;
+	auto counting_less = [&](std::uint64_t left, std::uint64_t right) { ++comparisons; return left < right; };
+	const auto sampled_random = analyze_runs_sampled(ints.begin(), ints.end(), counting_less);
+	BOOST_TEST(comparisons < ints.size() / 8);
+	BOOST_TEST(sampled_random.sampled);
+	const auto full_random = analyze_runs(ints.begin(), ints.end());
+	BOOST_TEST(sampled_random.entropy == full_random.entropy, boost::test_tools::tolerance(0.02));
+	BOOST_TEST(double(sampled_random.runs) == double(full_random.runs), boost::test_tools::tolerance(0.05));
+	std::sort(ints.begin(), ints.end());
+	const auto sampled_sorted = analyze_runs_sampled(ints.begin(), ints.end());
+	BOOST_TEST(sampled_sorted.sorted());
+	BOOST_TEST(sampled_sorted.longest_run == ints.size());
+}
+
+/* Counts moves and destructions, so a sort that relocates shows up as neither. */
+struct relocatable_handle
+{
+	relocatable_handle(int k, std::size_t i): key(std::make_unique<int>(k)), index(i) { }
+	relocatable_handle(relocatable_handle&& other) noexcept: key(std::move(other.key)), index(other.index) { ++moves; }
+	relocatable_handle& operator=(relocatable_handle&& other) noexcept
+	{
+		key = std::move(other.key);
+		index = other.index;
+		++moves;
+		return *this;
+	}
+	~relocatable_handle() { ++destructions; }
+
+	std::unique_ptr<int> key;
+	std::size_t index;
+	static inline std::size_t moves = 0;
+	static inline std::size_t destructions = 0;
+};
+
+namespace tim {
+template <>
+struct is_trivially_relocatable<relocatable_handle>: std::true_type {};
+} /* namespace tim */
+
+BOOST_AUTO_TEST_CASE(relocating_sort)
+{
+	static_assert(is_trivially_relocatable_v<std::unique_ptr<int>>);
+	static_assert(is_trivially_relocatable_v<std::pair<std::shared_ptr<int>, int>>);
+	static_assert(not is_trivially_relocatable_v<std::pair<std::unique_ptr<int>, std::list<int>>>);
+
+	// only noexcept comparisons sort by relocation
+	auto by_key = [](const relocatable_handle& left, const relocatable_handle& right) noexcept { return *left.key < *right.key; };
+	std::uniform_int_distribution<int> dist(0, 100);
+	for(std::size_t size: {100, 1000, 100000})
+	{
+		std::vector<relocatable_handle> handles;
+		handles.reserve(size);
+		std::vector<std::pair<int, std::size_t>> expected;
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			handles.emplace_back(dist(mt), i);
+			expected.emplace_back(*handles.back().key, i);
+		}
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+		relocatable_handle::moves = relocatable_handle::destructions = 0;
+		if(size == 1000)
+			tim::stable_sort(handles.begin(), handles.end(), by_key);
+		else
+			timsort(handles.begin(), handles.end(), by_key);
+		BOOST_TEST(relocatable_handle::moves == 0u);
+		BOOST_TEST(relocatable_handle::destructions == 0u);
+		std::vector<std::pair<int, std::size_t>> sorted;
+		for(const auto& handle: handles)
+			sorted.emplace_back(*handle.key, handle.index);
+		BOOST_TEST((sorted == expected));
+	}
+
+	// the standard types that are specialized
+	std::vector<std::vector<int>> vectors(20000);
+	for(auto& v: vectors)
+		v.assign(dist(mt) % 4, dist(mt));
+	auto expected = vectors;
+	std::stable_sort(expected.begin(), expected.end());
+	timsort(vectors.begin(), vectors.end());
+	BOOST_TEST((vectors == expected));
+	std::vector<std::unique_ptr<int>> pointers;
+	for(int i = 0; i < 20000; ++i)
+		pointers.push_back(std::make_unique<int>(dist(mt)));
+	timsort(pointers.begin(), pointers.end(), [](const auto& left, const auto& right) noexcept { return *left < *right; });
+	BOOST_TEST(std::is_sorted(pointers.begin(), pointers.end(), [](const auto& left, const auto& right) { return *left < *right; }));
+
+	// others move as usual, so a comparison that throws propagates, and
+	// leaves no element owned twice
+	std::vector<relocatable_handle> handles;
+	for(std::size_t i = 0; i < 10000; ++i)
+		handles.emplace_back(dist(mt), i);
+	relocatable_handle::moves = 0;
+	timsort(handles.begin(), handles.end(), [](const auto& left, const auto& right) { return *left.key < *right.key; });
+	BOOST_TEST(relocatable_handle::moves > 0u);
+	std::shuffle(pointers.begin(), pointers.end(), mt);
+	std::size_t comparisons = 0;
+	auto throws_eventually = [&](const auto& left, const auto& right) {
+		if(++comparisons == 100000)
+			throw std::runtime_error("comparison failed");
+		return *left < *right;
+	};
+	BOOST_CHECK_THROW(timsort(pointers.begin(), pointers.end(), throws_eventually), std::runtime_error);
+	std::vector<int*> owned;
+	for(const auto& pointer: pointers)
+	{
+		if(pointer)
+			owned.push_back(pointer.get());
+	}
+	std::sort(owned.begin(), owned.end());
+	BOOST_TEST((std::adjacent_find(owned.begin(), owned.end()) == owned.end()));
+}
+
+/* Stand-in for a container's own iterator type, opted in to the memcpy() paths below. */
+template <class T>
+struct arena_iterator
+{
+	using value_type = T;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T*;
+	using reference = T&;
+	using iterator_category = std::random_access_iterator_tag;
+
+	T& operator*() const { return *ptr; }
+	T* operator->() const { return ptr; }
+	T& operator[](std::ptrdiff_t n) const { return ptr[n]; }
+	arena_iterator& operator++() { ++ptr; return *this; }
+	arena_iterator& operator--() { --ptr; return *this; }
+	arena_iterator operator++(int) { return {ptr++}; }
+	arena_iterator operator--(int) { return {ptr--}; }
+	arena_iterator& operator+=(std::ptrdiff_t n) { ptr += n; return *this; }
+	arena_iterator& operator-=(std::ptrdiff_t n) { ptr -= n; return *this; }
+	friend arena_iterator operator+(arena_iterator it, std::ptrdiff_t n) { return {it.ptr + n}; }
+	friend arena_iterator operator+(std::ptrdiff_t n, arena_iterator it) { return {it.ptr + n}; }
+	friend arena_iterator operator-(arena_iterator it, std::ptrdiff_t n) { return {it.ptr - n}; }
+	friend std::ptrdiff_t operator-(arena_iterator left, arena_iterator right) { return left.ptr - right.ptr; }
+	friend bool operator==(arena_iterator left, arena_iterator right) { return left.ptr == right.ptr; }
+	friend bool operator!=(arena_iterator left, arena_iterator right) { return left.ptr != right.ptr; }
+	friend bool operator<(arena_iterator left, arena_iterator right) { return left.ptr < right.ptr; }
+	friend bool operator>(arena_iterator left, arena_iterator right) { return left.ptr > right.ptr; }
+	friend bool operator<=(arena_iterator left, arena_iterator right) { return left.ptr <= right.ptr; }
+	friend bool operator>=(arena_iterator left, arena_iterator right) { return left.ptr >= right.ptr; }
+
+	T* ptr;
+};
+
+namespace tim {
+template <class T>
+struct is_contiguous_iterator<arena_iterator<T>>: std::true_type {};
+} /* namespace tim */
+
+BOOST_AUTO_TEST_CASE(contiguous_iterator_detection)
+{
+	static_assert(internal::is_contiguous_iterator_v<std::vector<int>::const_iterator>);
+	static_assert(internal::is_contiguous_iterator_v<std::string_view::const_iterator>);
+	static_assert(internal::is_contiguous_iterator_v<arena_iterator<int>>);
+	static_assert(internal::is_reverse_contiguous_iterator_v<std::reverse_iterator<arena_iterator<int>>>);
+	static_assert(not internal::is_contiguous_iterator_v<std::reverse_iterator<arena_iterator<int>>>);
+	static_assert(not internal::is_contiguous_iterator_v<std::list<int>::iterator>);
+	static_assert(not internal::is_contiguous_iterator_v<std::vector<bool>::iterator>);
+
+	// opted-in iterators get the memcpy() merges, forwards and in reverse.
+	// keys in the high half, original positions in the low half.
+	std::vector<std::uint64_t> data(100000);
+	std::uniform_int_distribution<std::uint64_t> dist(0, 1000);
+	for(std::size_t i = 0; i < data.size(); ++i)
+		data[i] = (dist(mt) << 32) | i;
+	auto by_key = [](std::uint64_t left, std::uint64_t right) { return (left >> 32) < (right >> 32); };
+	auto expected = data;
+	std::stable_sort(expected.begin(), expected.end(), by_key);
+	sort_stats stats;
+	const arena_iterator<std::uint64_t> begin{data.data()};
+	const arena_iterator<std::uint64_t> end = begin + data.size();
+	timsort(begin, end, by_key, stats);
+	BOOST_TEST((data == expected));
+	BOOST_TEST(stats.memcpy_bytes > 0u);
+
+	std::shuffle(data.begin(), data.end(), mt);
+	expected.assign(data.rbegin(), data.rend());
+	std::stable_sort(expected.begin(), expected.end(), by_key);
+	stats = {};
+	timsort(std::make_reverse_iterator(end), std::make_reverse_iterator(begin), by_key, stats);
+	BOOST_TEST(std::equal(data.rbegin(), data.rend(), expected.begin(), expected.end()));
+	BOOST_TEST(stats.memcpy_bytes > 0u);
+}
+
+struct wide_record
+{
+	std::uint64_t key;
+	std::uint64_t index;
+	std::uint64_t padding[2];
+	bool operator==(const wide_record& other) const { return key == other.key and index == other.index; }
+};
+
+static bool wide_record_key_less(const wide_record& left, const wide_record& right)
+{
+	return left.key < right.key;
+}
+
+/*
+ * Overlapping sorted blocks of wide records, each a half to three fifths
+ * of the rest of the range.  That keeps the run stack's invariants, so
+ * none of them get merged until the final collapse, which then merges
+ * them all at once.
+ */
+static std::vector<wide_record> overlapping_sorted_blocks(std::size_t size)
+{
+	std::uniform_int_distribution<std::uint64_t> dist(0, 5000);
+	std::vector<wide_record> data(size);
+	for(std::size_t i = 0; i < size; ++i)
+		data[i] = {dist(mt), i, {}};
+	for(std::size_t i = 0; i < size;)
+	{
+		const std::size_t rest = size - i;
+		std::uniform_int_distribution<std::size_t> jitter(0, rest / 10);
+		const std::size_t len = rest < 500 ? rest : rest / 2 + jitter(mt);
+		std::stable_sort(data.begin() + i, data.begin() + (i + len), wide_record_key_less);
+		i += len;
+	}
+	return data;
+}
+
+BOOST_AUTO_TEST_CASE(multiway_collapse_stable)
+{
+	auto by_key = wide_record_key_less;
+	for(std::size_t size: {1000, 50000, 300000})
+	{
+		const auto data = overlapping_sorted_blocks(size);
+		auto expected = data;
+		std::stable_sort(expected.begin(), expected.end(), by_key);
+		auto sorted = data;
+		sort_stats stats;
+		timsort(sorted.begin(), sorted.end(), by_key, stats);
+		BOOST_TEST((sorted == expected));
+		BOOST_TEST(stats.merges + 1 == stats.runs);
+		if(size >= 50000)
+			BOOST_TEST(stats.multiway_merges > 0u);
+		sorted = data;
+		timsort<powersort_merge_policy>(sorted.begin(), sorted.end(), by_key);
+		BOOST_TEST((sorted == expected));
+		// a scratch buffer of exactly scratch_elements_needed(size)
+		sorted = data;
+		std::vector<wide_record> scratch(scratch_elements_needed(size));
+		timsort(sorted.begin(), sorted.end(), by_key, scratch_span(scratch));
+		BOOST_TEST((sorted == expected));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(caller_scratch_stable)
+{
+	std::vector<std::pair<int, std::size_t>> data;
+	std::vector<std::pair<int, std::size_t>> scratch;
+	for(std::size_t size: {0, 1, 65, 1000, 100000})
+	{
+		// too small for anything, too small for most merges, and big enough
+		for(std::size_t scratch_size: {std::size_t(0), std::size_t(7), size / 16, scratch_elements_needed(size)})
+		{
+			scratch.assign(scratch_size, {});
+			auto with_scratch = [&](auto begin, auto end, auto comp) {
+				timsort(begin, end, comp, scratch_span(scratch));
+			};
+			data = make_keyed_pairs(size, 50);
+			std::uniform_int_distribution<int> dist(0, 50);
+			test_stable_sort_with(with_scratch, data.begin(), data.end(), by_first, std::equal_to<>{});
+			// mostly-descending data merges from the right
+			std::sort(data.begin(), data.end(), [](const auto& l, const auto& r) { return l.first > r.first; });
+			std::uniform_int_distribution<std::size_t> pos(0, size);
+			for(std::size_t i = 0; i < size / 100; ++i)
+				data[pos(mt) % size].first = dist(mt);
+			test_stable_sort_with(with_scratch, data.begin(), data.end(), by_first, std::equal_to<>{});
+		}
+	}
+	// elements bigger than the stack buffer, with no scratch or room for one
+	// element: every merge is done with rotations, down to single elements
+	std::vector<big_keyed_pair> big_scratch(1);
+	for(std::size_t scratch_size: {0, 1})
+	{
+		auto big = make_big_keyed_pairs(300, 20);
+		test_stable_sort_with([&](auto begin, auto end, auto comp) {
+				timsort(begin, end, comp, scratch_span(big_scratch.data(), scratch_size));
+			}, big.begin(), big.end(), by_first, std::equal_to<>{});
+	}
+	std::vector<std::string> strs(50000);
+	std::string str_scratch[100];
+	random_strs(strs.begin(), strs.end(), 0, 16, 'a', 'c');
+	test_stable_sort_with([&](auto begin, auto end, auto comp) { timsort(begin, end, comp, scratch_span(str_scratch)); },
+			      strs.begin(), strs.end(), std::greater<>{}, std::equal_to<>{});
+}
+
+BOOST_AUTO_TEST_CASE(merge_buffer_cache_reuse)
+{
+	using value_t = std::pair<int, std::size_t>;
+	const auto& cache = internal::thread_merge_buffer_cache<value_t>();
+	std::vector<value_t> data(100000);
+	auto fill = [&]() { data = make_keyed_pairs(data.size(), 50); };
+	// disabled by default
+	fill();
+	test_stable_sort(data.begin(), data.end(), by_first, std::equal_to<>{});
+	BOOST_TEST(cache.capacity == 0u);
+
+	set_merge_buffer_cache_limit<value_t>(data.size());
+	fill();
+	test_stable_sort(data.begin(), data.end(), by_first, std::equal_to<>{});
+	const auto cached = cache.capacity;
+	BOOST_TEST(cached > 0u);
+	BOOST_TEST(cached <= data.size());
+	// the next sort reuses (and gives back) the buffer, growing it if needed
+	fill();
+	test_stable_sort(data.begin(), data.end(), by_first, std::equal_to<>{});
+	BOOST_TEST(cache.capacity >= cached);
+
+	release_merge_buffer_cache<value_t>();
+	BOOST_TEST(cache.capacity == 0u);
+	// buffers over the limit aren't kept
+	set_merge_buffer_cache_limit<value_t>(10);
+	fill();
+	test_stable_sort(data.begin(), data.end(), by_first, std::equal_to<>{});
+	BOOST_TEST(cache.capacity == 0u);
+	set_merge_buffer_cache_limit<value_t>(0);
+}
+
+/* Allocator that counts what it hands out, to check where merge buffers come from. */
+template <class T>
+struct counting_allocator
+{
+	using value_type = T;
+
+	counting_allocator(std::size_t* live_count, std::size_t* allocation_count) noexcept:
+		live(live_count), allocations(allocation_count)
+	{
+
+	}
+
+	template <class U>
+	counting_allocator(const counting_allocator<U>& other) noexcept:
+		live(other.live), allocations(other.allocations)
+	{
+
+	}
+
+	T* allocate(std::size_t n)
+	{
+		++*allocations;
+		*live += n * sizeof(T);
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept
+	{
+		*live -= n * sizeof(T);
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template <class U>
+	bool operator==(const counting_allocator<U>& other) const noexcept { return live == other.live; }
+	template <class U>
+	bool operator!=(const counting_allocator<U>& other) const noexcept { return live != other.live; }
+
+	std::size_t* live;
+	std::size_t* allocations;
+};
+
+BOOST_AUTO_TEST_CASE(allocator_scratch_sorts)
+{
+	std::size_t live = 0;
+	std::size_t allocations = 0;
+	// rebound from the type it's given to the element type
+	const counting_allocator<char> alloc(&live, &allocations);
+	auto data = make_keyed_pairs(100000, 50);
+	test_stable_sort_with([&](auto begin, auto end, auto comp) { timsort(begin, end, comp, std::allocator_arg, alloc); },
+			      data.begin(), data.end(), by_first, std::equal_to<>{});
+	BOOST_TEST(allocations > 0u);
+	BOOST_TEST(live == 0u);
+
+	allocations = 0;
+	std::vector<std::string> strs(50000);
+	random_strs(strs.begin(), strs.end(), 0, 16, 'a', 'c');
+	test_stable_sort_with([&](auto begin, auto end, auto comp) { timsort(begin, end, comp, std::allocator_arg, alloc); },
+			      strs.begin(), strs.end(), std::greater<>{}, std::equal_to<>{});
+	BOOST_TEST(allocations > 0u);
+	BOOST_TEST(live == 0u);
+
+	// trivially relocatable types are sorted by relocation with it too
+	allocations = 0;
+	std::vector<relocatable_handle> handles;
+	std::uniform_int_distribution<int> dist(0, 50);
+	for(std::size_t i = 0; i < 10000; ++i)
+		handles.emplace_back(dist(mt), i);
+	relocatable_handle::moves = 0;
+	timsort(handles.begin(), handles.end(),
+		[](const auto& left, const auto& right) noexcept { return *left.key < *right.key; }, std::allocator_arg, alloc);
+	BOOST_TEST(relocatable_handle::moves == 0u);
+	BOOST_TEST(allocations > 0u);
+	BOOST_TEST(live == 0u);
+	BOOST_TEST(std::is_sorted(handles.begin(), handles.end(),
+		[](const auto& left, const auto& right) { return *left.key < *right.key; }));
+
+#ifdef __cpp_lib_memory_resource
+	// everything comes out of an arena of twice the range's size: its
+	// upstream refuses to allocate
+	std::vector<std::byte> arena(2 * data.size() * sizeof(data[0]));
+	std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size(), std::pmr::null_memory_resource());
+	data = make_keyed_pairs(data.size(), 50);
+	test_stable_sort_with([&](auto begin, auto end, auto comp) { timsort(begin, end, comp, &resource); },
+			      data.begin(), data.end(), by_first, std::equal_to<>{});
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(stable_sort_out_of_memory)
+{
+	std::vector<std::pair<int, std::size_t>> data(100000);
+	auto fill = [&]() { data = make_keyed_pairs(data.size(), 50); };
+	auto sort_with_little_memory = [](auto sort) {
+		return [=](auto begin, auto end, auto comp) {
+			max_allocation_size = 4096;
+			try
+			{
+				sort(begin, end, comp);
+			}
+			catch(...)
+			{
+				max_allocation_size = std::numeric_limits<std::size_t>::max();
+				throw;
+			}
+			max_allocation_size = std::numeric_limits<std::size_t>::max();
+		};
+	};
+	fill();
+	test_stable_sort_with([](auto begin, auto end, auto comp) { tim::stable_sort(begin, end, comp); },
+			      data.begin(), data.end(), by_first, std::equal_to<>{});
+	// merges that get memory use it, the rest are done in place
+	fill();
+	test_stable_sort_with(sort_with_little_memory([](auto begin, auto end, auto comp) { tim::stable_sort(begin, end, comp); }),
+			      data.begin(), data.end(), by_first, std::equal_to<>{});
+	std::vector<std::string> strs(50000);
+	random_strs(strs.begin(), strs.end(), 0, 8, 'a', 'c');
+	test_stable_sort_with(sort_with_little_memory([](auto begin, auto end, auto comp) { tim::stable_sort(begin, end, comp); }),
+			      strs.begin(), strs.end(), std::greater<>{}, std::equal_to<>{});
+	// whereas timsort() gives up
+	fill();
+	auto original = data;
+	BOOST_CHECK_THROW(sort_with_little_memory([](auto begin, auto end, auto comp) { timsort(begin, end, comp); })(data.begin(), data.end(), by_first),
+			  std::bad_alloc);
+	BOOST_TEST(std::is_permutation(data.begin(), data.end(), original.begin(), original.end()));
+
+	// the multiway collapse gets by on the stack and the merge buffer, so
+	// with no memory at all, stable_sort() and caller-supplied scratch still work
+	const auto records = overlapping_sorted_blocks(300000);
+	auto expected = records;
+	std::stable_sort(expected.begin(), expected.end(), wide_record_key_less);
+	std::vector<wide_record> scratch(scratch_elements_needed(records.size()));
+	for(bool use_scratch: {false, true})
+	{
+		auto sorted = records;
+		max_allocation_size = 0;
+		try
+		{
+			if(use_scratch)
+				timsort(sorted.begin(), sorted.end(), wide_record_key_less, scratch_span(scratch));
+			else
+				tim::stable_sort(sorted.begin(), sorted.end(), wide_record_key_less);
+		}
+		catch(...)
+		{
+			max_allocation_size = std::numeric_limits<std::size_t>::max();
+			throw;
+		}
+		max_allocation_size = std::numeric_limits<std::size_t>::max();
+		BOOST_TEST((sorted == expected));
+	}
+
+	// elements bigger than the stack buffer and no memory for even one more
+	auto big = make_big_keyed_pairs(300, 20);
+	test_stable_sort_with([](auto begin, auto end, auto comp) {
+			max_allocation_size = 0;
+			tim::stable_sort(begin, end, comp);
+			max_allocation_size = std::numeric_limits<std::size_t>::max();
+		}, big.begin(), big.end(), by_first, std::equal_to<>{});
+}
+
+BOOST_AUTO_TEST_CASE(sort_stats_counts)
+{
+	const std::size_t size = 100000;
+	std::vector<int> ints(size);
+	// already sorted: one run, no merges
+	std::iota(ints.begin(), ints.end(), 0);
+	sort_stats stats;
+	timsort(ints.begin(), ints.end(), std::less<>{}, stats);
+	BOOST_TEST(stats.comparisons == size - 1);
+	BOOST_TEST(stats.runs == 1u);
+	BOOST_TEST(stats.merges == 0u);
+	BOOST_TEST(stats.longest_natural_run == size);
+
+	// strictly descending
+	std::reverse(ints.begin(), ints.end());
+	stats = {};
+	timsort(ints.begin(), ints.end(), std::less<>{}, stats);
+	BOOST_TEST(std::is_sorted(ints.begin(), ints.end()));
+	BOOST_TEST(stats.runs == 1u);
+	BOOST_TEST(stats.descending_runs == 1u);
+
+	// random
+	random_ints(ints.begin(), ints.end(), 0, 1000);
+	stats = {};
+	auto counted = [&](auto begin, auto end, auto comp) { timsort(begin, end, comp, stats); };
+	test_stable_sort_with(counted, ints.begin(), ints.end(), std::less<>{}, std::equal_to<>{});
+	BOOST_TEST(stats.runs > 1u);
+	BOOST_TEST(stats.merges == stats.runs - 1);
+	BOOST_TEST(stats.forced_runs > 0u);
+	BOOST_TEST(stats.stack_buffer_merges + stats.scratch_buffer_merges >= stats.merges);
+	BOOST_TEST(stats.memcpy_bytes > 0u);
+	BOOST_TEST(stats.minrun == internal::compute_minrun<int>(size));
+	BOOST_TEST(stats.radix_runs > 0u);
+	BOOST_TEST(std::accumulate(std::begin(stats.natural_run_lengths), std::end(stats.natural_run_lengths), std::size_t(0)) == stats.runs - stats.radix_runs);
+
+	// not trivially copyable: nothing gets memcpy()'d
+	std::vector<std::string> strs(size);
+	random_strs(strs.begin(), strs.end(), 0, 8, 'a', 'z');
+	stats = {};
+	test_stable_sort_with(counted, strs.begin(), strs.end(), std::greater<>{}, std::equal_to<>{});
+	BOOST_TEST(stats.memcpy_bytes == 0u);
+	BOOST_TEST(stats.element_moves > 0u);
+	BOOST_TEST(stats.comparisons > size);
+}
+
+BOOST_AUTO_TEST_CASE(projection_stable)
+{
+	struct record
+	{
+		int key;
+		std::size_t index;
+		char payload[64];
+		bool operator==(const record& other) const { return key == other.key and index == other.index; }
+	};
+	static_assert(internal::use_key_cache_v<std::vector<record>::iterator, decltype(&record::key)>);
+	static_assert(not internal::use_key_cache_v<std::vector<std::pair<int, std::size_t>>::iterator, 
+						     decltype(&std::pair<int, std::size_t>::first)>);
+	for(std::size_t size: {0, 1, 2, 65, 1000, 100000})
+	{
+		std::uniform_int_distribution<int> dist(0, 50);
+		// light elements, key by reference: sorted directly
+		auto pairs = make_keyed_pairs(size, 50);
+		test_stable_sort_with([](auto begin, auto end, auto) { timsort(begin, end, std::greater<>{}, &std::pair<int, std::size_t>::first); },
+				      pairs.begin(), pairs.end(), 
+				      [](const auto& l, const auto& r) { return l.first > r.first; }, std::equal_to<>{});
+		// heavy elements: keys cached as pointers
+		std::vector<record> records(size);
+		for(std::size_t i = 0; i < size; ++i)
+			records[i] = record{dist(mt), i, {}};
+		test_stable_sort_with([](auto begin, auto end, auto) { timsort(begin, end, std::less<>{}, &record::key); },
+				      records.begin(), records.end(), 
+				      [](const auto& l, const auto& r) { return l.key < r.key; }, std::equal_to<>{});
+		// computed keys: cached by value
+		std::vector<std::string> strs(size);
+		random_strs(strs.begin(), strs.end(), 0, 32, 'a', 'z');
+		auto length = [](const std::string& str) { return str.size(); };
+		test_stable_sort_with([&](auto begin, auto end, auto) { timsort(begin, end, std::less<>{}, length); },
+				      strs.begin(), strs.end(), 
+				      [&](const auto& l, const auto& r) { return length(l) < length(r); }, std::equal_to<>{});
+	}
+}
+
+BOOST_AUTO_TEST_CASE(argsort_permutations)
+{
+	for(std::size_t size: {0, 1, 40, 1000, 100000})
+	{
+		auto data = make_keyed_pairs(size, 100);
+		auto expected = data;
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+
+		// equal keys keep their indices in order
+		const auto indices = argsort(data.begin(), data.end(), by_first);
+		BOOST_TEST_REQUIRE(indices.size() == size);
+		for(std::size_t i = 0; i < size; ++i)
+			BOOST_TEST((data[indices[i]] == expected[i]));
+
+		std::vector<std::uint32_t> narrow(size);
+		argsort_into(data.begin(), data.end(), narrow.data(), by_first);
+		BOOST_TEST(std::equal(indices.begin(), indices.end(), narrow.begin(), narrow.end()));
+
+		apply_permutation(data.begin(), data.end(), narrow.begin());
+		BOOST_TEST((data == expected));
+		for(std::size_t i = 0; i < size; ++i)
+			BOOST_TEST(narrow[i] == i);
+	}
+
+	std::vector<std::string> strs(5000);
+	random_strs(strs.begin(), strs.end(), 0, 5, 'a', 'f');
+	auto order = argsort<std::uint16_t>(strs.begin(), strs.end(), std::greater<>{});
+	auto expected = strs;
+	std::stable_sort(expected.begin(), expected.end(), std::greater<>{});
+	apply_permutation(strs.begin(), strs.end(), order.begin());
+	BOOST_TEST((strs == expected));
+
+	std::vector<char> too_long(300);
+	std::vector<std::uint8_t> small_indices(300);
+	BOOST_CHECK_THROW(argsort_into(too_long.begin(), too_long.end(), small_indices.begin()), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(zip_columns_stable)
+{
+	std::uniform_int_distribution<int> dist(0, 100);
+	for(std::size_t size: {0, 1, 40, 1000, 100000})
+	{
+		// keys with lots of duplicates; the index column records the original order
+		std::vector<int> keys(size);
+		std::vector<std::size_t> indices(size);
+		std::vector<std::string> names(size);
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			keys[i] = dist(mt);
+			indices[i] = i;
+			names[i] = std::to_string(i);
+		}
+		std::vector<std::pair<int, std::size_t>> expected(size);
+		for(std::size_t i = 0; i < size; ++i)
+			expected[i] = {keys[i], i};
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+
+		timsort_zip(keys.begin(), keys.end(), std::less<>{}, indices.data(), names.begin());
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			BOOST_TEST(keys[i] == expected[i].first);
+			BOOST_TEST(indices[i] == expected[i].second);
+			BOOST_TEST(names[i] == std::to_string(expected[i].second));
+		}
+	}
+
+	// heavy keys are cached by pointer and moved into place after the payloads
+	std::vector<std::string> strs(5000);
+	random_strs(strs.begin(), strs.end(), 0, 5, 'a', 'f');
+	std::vector<std::size_t> order(strs.size());
+	std::iota(order.begin(), order.end(), std::size_t(0));
+	auto expected = strs;
+	std::stable_sort(expected.begin(), expected.end(), std::greater<>{});
+	auto original = strs;
+	timsort_zip<powersort_merge_policy>(strs.begin(), strs.end(), std::greater<>{}, order.begin());
+	BOOST_TEST((strs == expected));
+	for(std::size_t i = 0; i < strs.size(); ++i)
+		BOOST_TEST(original[order[i]] == strs[i]);
+}
+
+#if (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__) \
+	&& !defined TIMSORT_NO_USE_COMPILER_INTRINSICS && !defined TIMSORT_NO_SIMD_MERGE
+# define TEST_SIMD_MERGE_KERNELS 1
+#endif
+
+/* Whether timsort() merges long runs of 'T's with a vector kernel on this machine. */
+template <class T>
+bool simd_merges_expected()
+{
+#ifdef TEST_SIMD_MERGE_KERNELS
+	const auto level = internal::detect_simd_level();
+	return sizeof(T) == 4 ? level != internal::simd_level::none : level == internal::simd_level::avx2;
+#else
+	return false;
+#endif
+}
+
+template <class T, class Comp>
+void simd_merge_test(Comp comp)
+{
+	// vectorized merges only kick in for long runs.  mix in long presorted
+	// stretches so that merges run in both directions.
+	std::uniform_int_distribution<std::uint64_t> dist;
+	for(std::size_t size: {100, 1000, 100000, 1000003})
+	{
+		std::vector<T> data(size);
+		for(auto& elem: data)
+			elem = static_cast<T>(dist(mt));
+		test_stable_sort(data.begin(), data.end(), comp, std::equal_to<>{});
+		for(auto& elem: data)
+			elem = static_cast<T>(dist(mt) % 100);
+		std::sort(data.begin() + size / 3, data.end(), comp);
+		test_stable_sort(data.begin(), data.end(), comp, std::equal_to<>{});
+	}
+	// random data is mostly radix sorted (see radix_runs.h), so check that
+	// long sorted blocks actually get merged by the vector kernels
+	std::vector<T> blocks(100000);
+	for(auto& elem: blocks)
+		elem = static_cast<T>(dist(mt));
+	for(std::size_t i = 0; i < blocks.size(); i += 5000)
+		std::sort(blocks.begin() + i, blocks.begin() + i + 5000, comp);
+	auto expected = blocks;
+	std::stable_sort(expected.begin(), expected.end(), comp);
+	sort_stats stats;
+	timsort(blocks.begin(), blocks.end(), comp, stats);
+	BOOST_TEST((blocks == expected));
+	BOOST_TEST((stats.simd_merges > 0u) == simd_merges_expected<T>());
+}
+
+#ifdef TEST_SIMD_MERGE_KERNELS
+/*
+ * Call a merge kernel directly, forward and backward, on sorted runs of
+ * assorted lengths (at least one register's worth each), and compare with
+ * std::merge().  Ascending order only: the key mask takes care of the rest.
+ * As in timsort(), run 'a' is in a buffer and run 'b' is in place, right
+ * after (or, merging backward, right before) the gap that 'a' left.
+ */
+template <class T, class Kernel>
+void simd_merge_kernel_test(Kernel kernel)
+{
+	std::uniform_int_distribution<std::uint64_t> dist;
+	for(std::uint64_t modulus: {std::uint64_t(50), std::numeric_limits<std::uint64_t>::max()})
+	{
+		for(std::size_t a_size: {16, 17, 40, 1000})
+		{
+			for(std::size_t b_size: {16, 31, 999})
+			{
+				std::vector<T> a(a_size);
+				std::vector<T> b(b_size);
+				for(auto& elem: a)
+					elem = static_cast<T>(dist(mt) % modulus);
+				for(auto& elem: b)
+					elem = static_cast<T>(dist(mt) % modulus);
+				std::sort(a.begin(), a.end());
+				std::sort(b.begin(), b.end());
+				std::vector<T> expected(a_size + b_size);
+				std::merge(a.begin(), a.end(), b.begin(), b.end(), expected.begin());
+				std::vector<T> merged(expected.size());
+				T* const first = merged.data();
+				T* const last = merged.data() + merged.size();
+				std::copy(b.begin(), b.end(), first + a_size);
+				kernel(std::false_type{}, a.data(), a.data() + a_size, first + a_size, last, first);
+				BOOST_TEST((merged == expected));
+				std::fill(merged.begin(), merged.end(), T(0));
+				std::copy(b.begin(), b.end(), first);
+				kernel(std::true_type{}, a.data() + a_size, a.data(), first + b_size, first, last);
+				BOOST_TEST((merged == expected));
+			}
+		}
+	}
+}
+
+/* Adapts internal::simd_merge_<kernel><Traits, Backward> to simd_merge_kernel_test(). */
+#define TEST_SIMD_MERGE_KERNEL_(kernel, traits)								\
+	[](auto backward, const auto* a, const auto* a_end, const auto* b, const auto* b_end, auto* dest) {	\
+		using T = std::remove_pointer_t<decltype(dest)>;						\
+		if constexpr(decltype(backward)::value)								\
+			internal::kernel<internal::traits, true>(a, a_end, b, b_end, dest,			\
+								 internal::simd_key_mask<T, true>(), std::greater<>{});	\
+		else												\
+			internal::kernel<internal::traits, false>(a, a_end, b, b_end, dest,			\
+								  internal::simd_key_mask<T, false>(), std::less<>{});	\
+	}
+
+BOOST_AUTO_TEST_CASE(simd_merge_kernels)
+{
+	// every kernel the CPU can run, not just the one timsort() would pick
+	const auto level = internal::detect_simd_level();
+	if(level != internal::simd_level::none)
+	{
+		simd_merge_kernel_test<std::int32_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_sse41, sse41_epi32));
+		simd_merge_kernel_test<std::uint32_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_sse41, sse41_epi32));
+	}
+	if(level == internal::simd_level::avx2)
+	{
+		simd_merge_kernel_test<std::int32_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_avx2, avx2_epi32));
+		simd_merge_kernel_test<std::uint32_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_avx2, avx2_epi32));
+		simd_merge_kernel_test<std::int64_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_avx2, avx2_epi64));
+		simd_merge_kernel_test<std::uint64_t>(TEST_SIMD_MERGE_KERNEL_(simd_merge_avx2, avx2_epi64));
+	}
+}
+
+#undef TEST_SIMD_MERGE_KERNEL_
+#endif /* TEST_SIMD_MERGE_KERNELS */
+
+BOOST_AUTO_TEST_CASE(simd_merge_integers)
+{
+	simd_merge_test<int>(std::less<>{});
+	simd_merge_test<int>(std::greater<>{});
+	simd_merge_test<unsigned>(std::less<unsigned>{});
+	simd_merge_test<unsigned>(std::greater<>{});
+	simd_merge_test<std::int64_t>(std::less<>{});
+	simd_merge_test<std::int64_t>(std::greater<std::int64_t>{});
+	simd_merge_test<std::uint64_t>(std::less<>{});
+	simd_merge_test<std::uint64_t>(std::greater<>{});
+}
+
+template <class T, class Comp>
+void simd_run_scan_test(Comp comp)
+{
+	// long ascending and descending runs of random lengths, with ties (and,
+	// for floating point types, both zeros) that end strictly descending
+	// runs.  equal elements are compared bitwise so that +0.0 and -0.0 
+	// can't trade places unnoticed.
+	auto bitwise_equal = [](const T& left, const T& right) {
+		return std::memcmp(&left, &right, sizeof(T)) == 0;
+	};
+	std::uniform_int_distribution<int> value_dist(-50, 50);
+	std::uniform_int_distribution<std::size_t> length_dist(1, 300);
+	for(std::size_t size: {10, 100, 1000, 100000})
+	{
+		std::vector<T> data;
+		data.reserve(size);
+		bool descending = false;
+		while(data.size() < size)
+		{
+			const auto run_begin = data.size();
+			const auto run_end = std::min(size, run_begin + length_dist(mt));
+			for(auto i = run_begin; i < run_end; ++i)
+			{
+				const int value = value_dist(mt);
+				data.push_back(std::is_floating_point_v<T> and value == 0 and (i % 2) ? T(-0.0) : static_cast<T>(value));
+			}
+			if(descending)
+				std::sort(data.begin() + run_begin, data.end(), [&](const T& l, const T& r) { return comp(r, l); });
+			else
+				std::sort(data.begin() + run_begin, data.end(), comp);
+			descending = not descending;
+		}
+		test_stable_sort(data.begin(), data.end(), comp, bitwise_equal);
+		// one long strictly descending run
+		std::iota(data.begin(), data.end(), T(0));
+		if(comp(data.front(), data.back()))
+			std::reverse(data.begin(), data.end());
+		test_stable_sort(data.begin(), data.end(), comp, bitwise_equal);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(simd_run_scans)
+{
+	simd_run_scan_test<int>(std::less<>{});
+	simd_run_scan_test<int>(std::greater<>{});
+	simd_run_scan_test<unsigned>(std::less<unsigned>{});
+	simd_run_scan_test<std::int64_t>(std::greater<>{});
+	simd_run_scan_test<std::uint64_t>(std::less<>{});
+	simd_run_scan_test<float>(std::less<>{});
+	simd_run_scan_test<float>(std::greater<float>{});
+	simd_run_scan_test<double>(std::less<>{});
+	simd_run_scan_test<double>(std::greater<>{});
+}
+
+template <class T, class Comp>
+void radix_run_test(Comp comp)
+{
+	// random stretches get radix sorted, presorted ones don't.  values
+	// straddle zero (and both zeros show up) to check the key mapping, 
+	// and equal elements are compared bitwise so that +0.0 and -0.0 
+	// can't trade places unnoticed.
+	auto bitwise_equal = [](const T& left, const T& right) {
+		return std::memcmp(&left, &right, sizeof(T)) == 0;
+	};
+	std::uniform_int_distribution<int> dist(-1000, 1000);
+	const std::size_t stretch = internal::radix_run_length + 12345;
+	std::vector<T> data(5 * stretch);
+	for(std::size_t i = 0; i < data.size(); ++i)
+	{
+		const int value = dist(mt);
+		data[i] = std::is_floating_point_v<T> and value == 0 and (i % 2) ? T(-0.0) : static_cast<T>(value / 3);
+		if constexpr(std::is_floating_point_v<T>)
+			data[i] /= 7;
+	}
+	std::sort(data.begin() + stretch, data.begin() + 2 * stretch, comp);
+	std::sort(data.begin() + 3 * stretch, data.begin() + 4 * stretch, [&](const T& l, const T& r) { return comp(r, l); });
+	sort_stats stats;
+	test_stable_sort_with([&](auto begin, auto end, auto cmp) { timsort(begin, end, cmp, stats); },
+			      data.begin(), data.end(), comp, bitwise_equal);
+	BOOST_TEST(stats.radix_runs > 0u);
+	BOOST_TEST(stats.longest_natural_run >= stretch / 2);
+}
+
+BOOST_AUTO_TEST_CASE(radix_runs)
+{
+	radix_run_test<int>(std::less<>{});
+	radix_run_test<int>(std::greater<>{});
+	radix_run_test<unsigned>(std::less<>{});
+	radix_run_test<std::int16_t>(std::less<>{});
+	radix_run_test<std::int64_t>(std::greater<std::int64_t>{});
+	radix_run_test<float>(std::less<>{});
+	radix_run_test<double>(std::greater<>{});
+}
+
+BOOST_AUTO_TEST_CASE(run_vector_reads)
+{
+	// (key, append index) pairs compared by key only: reads have to match
+	// a stable sort of everything appended so far.
+	run_vector<std::pair<int, std::size_t>, std::decay_t<decltype(by_first)>> vec(by_first);
+	std::vector<std::pair<int, std::size_t>> expected;
+	std::uniform_int_distribution<int> dist(0, 1000);
+	std::uniform_int_distribution<std::size_t> batch_dist(0, 700);
+	for(std::size_t batch = 0; batch < 60; ++batch)
+	{
+		const std::size_t count = batch_dist(mt);
+		for(std::size_t i = 0; i < count; ++i)
+		{
+			// mostly increasing keys, like timestamps
+			const int key = (i % 10 == 0) ? dist(mt) : int(expected.size() / 8);
+			vec.push_back({key, expected.size()});
+			expected.push_back({key, expected.size()});
+		}
+		BOOST_TEST(vec.pending() == count);
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+		BOOST_TEST((vec.sorted() == expected));
+		BOOST_TEST(vec.pending() == 0u);
+	}
+	BOOST_TEST(vec.size() == expected.size());
+	BOOST_TEST((vec.release() == expected));
+	BOOST_TEST(vec.empty());
+
+	std::vector<std::string> strs(5000);
+	random_strs(strs.begin(), strs.end(), 0, 6, 'a', 'e');
+	run_vector<std::string, std::greater<>> str_vec(strs.begin(), strs.begin() + 2500);
+	BOOST_TEST(std::is_sorted(str_vec.begin(), str_vec.end(), std::greater<>{}));
+	str_vec.append(strs.begin() + 2500, strs.end());
+	std::stable_sort(strs.begin(), strs.end(), std::greater<>{});
+	// reads through a const reference still merge what's pending
+	const auto& const_vec = str_vec;
+	BOOST_TEST(const_vec.pending() == 2500u);
+	BOOST_TEST(std::equal(const_vec.begin(), const_vec.end(), strs.begin(), strs.end()));
+	BOOST_TEST(const_vec[0] == strs[0]);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_sort_steps)
+{
+	// small, random budgets split most merges into pieces
+	std::uniform_int_distribution<std::size_t> budget_dist(1, 5000);
+	for(std::size_t size: {0, 1, 100, 10000, 300000})
+	{
+		auto data = make_keyed_pairs(size, 100);
+		std::sort(data.begin(), data.begin() + size / 3, by_first);
+		test_stable_sort_with([&](auto begin, auto end, auto comp) {
+				incremental_sorter<decltype(begin), decltype(comp)> sorter(begin, end, comp);
+				while(sorter.step(budget_dist(mt)) == sort_status::running) { /* LOOP */ }
+				BOOST_TEST((sorter.status() == sort_status::done));
+			}, data.begin(), data.end(), by_first, std::equal_to<>{});
+	}
+
+	// cancelling part way through leaves a permutation of the input
+	std::vector<std::string> strs(200000);
+	random_strs(strs.begin(), strs.end(), 0, 8, 'a', 'z');
+	for(std::size_t steps: {0, 1, 10, 100})
+	{
+		auto data = strs;
+		cancellation_token token;
+		incremental_sorter<std::vector<std::string>::iterator> sorter(data.begin(), data.end(), {}, token);
+		for(std::size_t i = 0; i < steps; ++i)
+			sorter.step(3000);
+		token.cancel();
+		BOOST_TEST((sorter.step(3000) == sort_status::cancelled));
+		std::sort(data.begin(), data.end());
+		auto expected = strs;
+		std::sort(expected.begin(), expected.end());
+		BOOST_TEST((data == expected));
+	}
+	auto data = strs;
+	incremental_sorter<std::vector<std::string>::iterator, std::greater<>> sorter(data.begin(), data.end());
+	sorter.step(10000);
+	BOOST_TEST((sorter.run() == sort_status::done));
+	BOOST_TEST(std::is_sorted(data.begin(), data.end(), std::greater<>{}));
+
+	// long runs are found a budget at a time too: ascending with ties,
+	// strictly descending, and descending with an ascending continuation
+	const std::size_t size = 1000000;
+	const std::size_t budget = 4096;
+	for(int shape = 0; shape < 3; ++shape)
+	{
+		std::vector<std::pair<int, std::size_t>> pairs(size);
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			const std::size_t half = size / 2;
+			const std::size_t key = shape == 0 ? i / 4 : shape == 1 ? size - i : i < half ? half - i : i;
+			pairs[i] = {int(key), i};
+		}
+		auto expected = pairs;
+		std::stable_sort(expected.begin(), expected.end(), by_first);
+		std::size_t comparisons = 0;
+		auto counting = [&](const auto& left, const auto& right) { ++comparisons; return left.first < right.first; };
+		incremental_sorter<decltype(pairs.begin()), decltype(counting)> sorter(pairs.begin(), pairs.end(), counting);
+		std::size_t steps = 0;
+		std::size_t most = 0;
+		for(sort_status status = sort_status::running; status == sort_status::running; ++steps)
+		{
+			const std::size_t before = comparisons;
+			status = sorter.step(budget);
+			most = std::max(most, comparisons - before);
+		}
+		BOOST_TEST((pairs == expected));
+		BOOST_TEST(most <= 2 * budget);
+		BOOST_TEST(steps >= size / (2 * budget));
+	}
+}
+
+struct external_record
+{
+	std::uint32_t key;
+	std::uint32_t index;
+};
+
+static std::vector<external_record> read_records(const std::filesystem::path& path)
+{
+	std::vector<external_record> records(std::filesystem::file_size(path) / sizeof(external_record));
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	BOOST_TEST_REQUIRE(file);
+	BOOST_TEST(std::fread(records.data(), sizeof(external_record), records.size(), file) == records.size());
+	std::fclose(file);
+	return records;
+}
+
+static void write_records(const std::filesystem::path& path, const std::vector<external_record>& records)
+{
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	BOOST_TEST_REQUIRE(file);
+	BOOST_TEST(std::fwrite(records.data(), sizeof(external_record), records.size(), file) == records.size());
+	std::fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(external_sort_files)
+{
+	const auto dir = std::filesystem::temp_directory_path() / ("timsort-test-" + std::to_string(mt()));
+	std::filesystem::create_directories(dir);
+	const auto input = dir / "input";
+	const auto output = dir / "output";
+	auto by_key = [](const external_record& left, const external_record& right) { return left.key < right.key; };
+	auto same = [](const external_record& left, const external_record& right) {
+		return left.key == right.key and left.index == right.index;
+	};
+	// 64KiB budget, 4KiB blocks: ~5000-record chunks, merged 15 at a time
+	external_sort_options options;
+	options.memory_budget = 1 << 16;
+	options.io_block_size = 1 << 12;
+	options.temp_directory = dir;
+
+	std::vector<external_record> records(200000);
+	std::uniform_int_distribution<std::uint32_t> dist(0, 5000);
+	for(std::size_t i = 0; i < records.size(); ++i)
+		records[i] = {dist(mt), std::uint32_t(i)};
+	write_records(input, records);
+	external_sort_stats stats = external_sort<external_record>(input, output, by_key, options);
+	std::stable_sort(records.begin(), records.end(), by_key);
+	auto sorted = read_records(output);
+	BOOST_TEST(std::equal(sorted.begin(), sorted.end(), records.begin(), records.end(), same));
+	BOOST_TEST(stats.records == records.size());
+	BOOST_TEST(stats.runs > 15u);
+	BOOST_TEST(stats.merge_passes == 2u);
+
+	// presorted input is one run, and sorting in place works
+	stats = external_sort<external_record>(output, output, by_key, options);
+	BOOST_TEST(stats.runs == 1u);
+	BOOST_TEST(stats.merge_passes == 0u);
+	sorted = read_records(output);
+	BOOST_TEST(std::equal(sorted.begin(), sorted.end(), records.begin(), records.end(), same));
+
+	// input that fits in memory isn't spilled
+	records.resize(1000);
+	std::shuffle(records.begin(), records.end(), mt);
+	write_records(input, records);
+	stats = external_sort<external_record>(input, output, by_key, options);
+	BOOST_TEST(stats.runs == 0u);
+	std::stable_sort(records.begin(), records.end(), by_key);
+	sorted = read_records(output);
+	BOOST_TEST(std::equal(sorted.begin(), sorted.end(), records.begin(), records.end(), same));
+
+	// no temporary files are left behind
+	BOOST_TEST(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 2);
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(mapped_sort_files)
+{
+	const auto dir = std::filesystem::temp_directory_path() / ("timsort-test-" + std::to_string(mt()));
+	std::filesystem::create_directories(dir);
+	const auto path = dir / "records";
+	auto by_key = [](const external_record& left, const external_record& right) { return left.key < right.key; };
+	auto same = [](const external_record& left, const external_record& right) {
+		return left.key == right.key and left.index == right.index;
+	};
+	mapped_sort_options options;
+	options.temp_directory = dir;
+	std::uniform_int_distribution<std::uint32_t> dist(0, 1000);
+	for(auto scratch: {mapped_scratch::anonymous, mapped_scratch::temp_file})
+	{
+		options.scratch = scratch;
+		for(std::size_t count: {0, 1, 100, 100000})
+		{
+			std::vector<external_record> records(count);
+			for(std::size_t i = 0; i < records.size(); ++i)
+				records[i] = {dist(mt), std::uint32_t(i)};
+			write_records(path, records);
+			BOOST_TEST(mapped_sort<external_record>(path, by_key, options) == count);
+			std::stable_sort(records.begin(), records.end(), by_key);
+			const auto sorted = read_records(path);
+			BOOST_TEST(std::equal(sorted.begin(), sorted.end(), records.begin(), records.end(), same));
+		}
+	}
+	// the temporary file for the scratch buffer is already gone
+	BOOST_TEST(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 1);
+
+	std::vector<std::uint64_t> ints(50000);
+	random_ints(ints.begin(), ints.end(), 0, 1u << 20);
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	BOOST_TEST(std::fwrite(ints.data(), sizeof(std::uint64_t), ints.size(), file) == ints.size());
+	std::fclose(file);
+	BOOST_TEST(mapped_sort<std::uint64_t>(path) == ints.size());
+	std::sort(ints.begin(), ints.end());
+	std::vector<std::uint64_t> sorted(ints.size());
+	file = std::fopen(path.c_str(), "rb");
+	BOOST_TEST(std::fread(sorted.data(), sizeof(std::uint64_t), sorted.size(), file) == sorted.size());
+	std::fclose(file);
+	BOOST_TEST((sorted == ints));
+	std::filesystem::remove_all(dir);
+}
+
+struct small_sorted_record
+{
+	int key;
+	std::size_t index;
+	bool operator==(const small_sorted_record& other) const { return key == other.key and index == other.index; }
+};
+
+static std::size_t small_sorter_calls = 0;
+
+template <>
+struct tim::small_sorter<small_sorted_record>
+{
+	template <class It, class Comp>
+	static void sort(It begin, It mid, It end, Comp comp)
+	{
+		++small_sorter_calls;
+		std::stable_sort(mid, end, comp);
+		std::inplace_merge(begin, mid, end, comp);
+	}
+};
+
+/* Trivially relocatable, with a kernel of its own that relocation mustn't bypass. */
+struct relocatable_small_sorted
+{
+	std::unique_ptr<int> key;
+	std::size_t index;
+};
+
+template <>
+struct tim::is_trivially_relocatable<relocatable_small_sorted>: std::true_type {};
+
+static std::size_t relocatable_small_sorter_calls = 0;
+
+template <>
+struct tim::small_sorter<relocatable_small_sorted>
+{
+	template <class It, class Comp>
+	static void sort(It begin, It mid, It end, Comp comp)
+	{
+		++relocatable_small_sorter_calls;
+		std::stable_sort(mid, end, comp);
+		std::inplace_merge(begin, mid, end, comp);
+	}
+};
+
+BOOST_AUTO_TEST_CASE(small_sort_kernels)
+{
+	// every length up to and past max_minrun, so that the sorting networks,
+	// the leftover insertion sorts and the final merges all get exercised
+	for(std::size_t size = 0; size < 300; ++size)
+	{
+		std::vector<int> ints(size);
+		random_ints(ints.begin(), ints.end(), 0, size % 2 ? 10 : 1000000);
+		test_stable_sort(ints.begin(), ints.end(), std::less<>{}, std::equal_to<>{});
+		random_ints(ints.begin(), ints.end(), 0, size % 2 ? 10 : 1000000);
+		test_stable_sort(ints.begin(), ints.end(), std::greater<>{}, std::equal_to<>{});
+		std::vector<std::uint64_t> longs(size);
+		random_ints(longs.begin(), longs.end(), 0, 100);
+		test_stable_sort(longs.begin(), longs.end(), std::less<>{}, std::equal_to<>{});
+	}
+
+	// user-supplied kernel
+	std::vector<small_sorted_record> records(10000);
+	std::uniform_int_distribution<int> dist(0, 100);
+	for(std::size_t i = 0; i < records.size(); ++i)
+		records[i] = {dist(mt), i};
+	auto by_key = [](const auto& left, const auto& right) { return left.key < right.key; };
+	test_stable_sort(records.begin(), records.end(), by_key, std::equal_to<>{});
+	BOOST_TEST(small_sorter_calls > 0u);
+
+	// ... even for trivially relocatable types with noexcept comparisons
+	static_assert(not internal::has_default_small_sorter_v<relocatable_small_sorted>);
+	std::vector<relocatable_small_sorted> relocatable(10000);
+	for(std::size_t i = 0; i < relocatable.size(); ++i)
+		relocatable[i] = {std::make_unique<int>(dist(mt)), i};
+	timsort(relocatable.begin(), relocatable.end(), [](const auto& left, const auto& right) noexcept { return *left.key < *right.key; });
+	BOOST_TEST(relocatable_small_sorter_calls > 0u);
+	BOOST_TEST(std::is_sorted(relocatable.begin(), relocatable.end(), [](const auto& left, const auto& right) {
+		return std::tie(*left.key, left.index) < std::tie(*right.key, right.index);
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_timsort_stable)
+{
+	// (key, original index) pairs compared by key only so that any
+	// instability shows up as a mismatch against std::stable_sort().
+	for(std::size_t threads: {1, 2, 3, 8})
+	{
+		for(std::size_t size: {0, 1, 1000, 100000, 300001})
+		{
+			auto data = make_keyed_pairs(size, 100);
+			test_stable_sort_with([&](auto begin, auto end, auto comp) {
+					timsort(parallel_policy(thread_executor(threads)), begin, end, comp);
+				}, data.begin(), data.end(), by_first, std::equal_to<>{});
+		}
+	}
+	std::vector<std::string> strs(200000);
+	random_strs(strs.begin(), strs.end(), 0, 16, 'a', 'c');
+	test_stable_sort_with([](auto begin, auto end, auto comp) { timsort(std::execution::par, begin, end, comp); },
+			      strs.begin(), strs.end(), std::less<>{}, std::equal_to<>{});
+
+	// sorted except for the two ends swapped: each chunk is one run, and
+	// the merges only gallop past the strays rather than comparing every
+	// element at every level of the merge tree
+	std::vector<int> ints(1000000);
+	std::iota(ints.begin(), ints.end(), 0);
+	std::swap(ints.front(), ints.back());
+	for(std::size_t threads: {2, 8})
+	{
+		auto sorted = ints;
+		std::atomic<std::size_t> comparisons{0};
+		timsort(parallel_policy(thread_executor(threads)), sorted.begin(), sorted.end(),
+			[&](int left, int right) { ++comparisons; return left < right; });
+		BOOST_TEST(std::is_sorted(sorted.begin(), sorted.end()));
+		BOOST_TEST(comparisons.load() < ints.size() + ints.size() / 4);
+	}
+
+#if defined(__cpp_lib_execution) && __cpp_lib_execution >= 201902L
+	// unseq doesn't allow the comparator to run on other threads
+	auto unseq = ints;
+	const auto caller = std::this_thread::get_id();
+	bool same_thread = true;
+	timsort(std::execution::unseq, unseq.begin(), unseq.end(),
+		[&](int left, int right) { same_thread = same_thread and std::this_thread::get_id() == caller; return left < right; });
+	BOOST_TEST(std::is_sorted(unseq.begin(), unseq.end()));
+	BOOST_TEST(same_thread);
+#endif
+}
+
 
 static const std::vector<int_params_t<std::less<>>> int_params_less{
 	{0,        1, std::less<>(), std::equal_to<>(), {0, 1, 2, 3, 10, 1000}}, 